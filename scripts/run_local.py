@@ -0,0 +1,303 @@
+#!/usr/bin/env python3
+"""Run an expr/*/run_list on this machine.
+
+Parses the run_list format used for the cluster scheduler:
+
+    set config_dir config
+    set mem_request 2
+    1..30 n32k8 /mnt/home/dk/bin/himalaya-nk --ea.rng.seed $seed --config nk.cfg
+
+and runs every (treatment, seed) in its own directory, var/<expr>/<treatment>/<seed>,
+into which the files of config_dir are copied.  Runs are packed onto the
+local cores, limited by memory as well as by core count; each run's address
+space is capped at mem_request GB (or --mem).
+
+Progress is kept in var/<expr>/results.sqlite, so interrupting and re-running
+this script picks up where it left off: finished runs are skipped, and runs
+that were interrupted are restarted from their latest checkpoint, if any (their
+*.dat files so far are kept in pre_resume/, as resuming truncates them).
+When a run finishes, its *.dat files, merged with any kept in pre_resume/,
+are loaded into the same database:
+
+    files(run_id, file, columns)  -- column names, as a JSON list
+    rows(run_id, file, line, data) -- one row per data line, as a JSON list
+
+Usage: scripts/run_local.py expr/001-alps [options]
+"""
+
+import argparse
+import glob
+import json
+import os
+import re
+import resource
+import shlex
+import shutil
+import signal
+import sqlite3
+import subprocess
+import sys
+import time
+
+PRE_RESUME = "pre_resume"
+RUN_RE = re.compile(r"^(\d+)(?:\.\.(\d+))?\s+(\S+)\s+(.*)$")
+
+
+def parse_run_list(path):
+    """Returns (settings, runs), where runs is a list of (name, seed, argv)."""
+    settings = {}
+    runs = []
+    with open(path) as f:
+        for n, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+            if line.startswith("set "):
+                parts = line.split(None, 2)
+                settings[parts[1]] = parts[2] if len(parts) > 2 else ""
+                continue
+            m = RUN_RE.match(line)
+            if m is None:
+                raise SystemExit("%s:%d: cannot parse: %s" % (path, n, line))
+            first = int(m.group(1))
+            last = int(m.group(2) or first)
+            for seed in range(first, last + 1):
+                cmd = m.group(4).replace("$seed", str(seed))
+                runs.append((m.group(3), seed, shlex.split(cmd)))
+    return settings, runs
+
+
+def locate(exe, bin_dir):
+    """Maps a cluster executable path onto this machine."""
+    if bin_dir:
+        return os.path.join(os.path.abspath(bin_dir), os.path.basename(exe))
+    if os.path.exists(exe):
+        return exe
+    found = shutil.which(os.path.basename(exe))
+    if found is None:
+        found = os.path.join(os.path.expanduser("~/bin"), os.path.basename(exe))
+    return found
+
+
+def available_memory_gb():
+    with open("/proc/meminfo") as f:
+        for line in f:
+            if line.startswith("MemAvailable:"):
+                return int(line.split()[1]) / (1024.0 * 1024.0)
+    return float("inf")
+
+
+def latest_checkpoint(run_dir, prefix):
+    files = glob.glob(os.path.join(run_dir, prefix + "*"))
+    return max(files, key=os.path.getmtime) if files else None
+
+
+def open_db(path):
+    db = sqlite3.connect(path)
+    db.executescript("""
+        create table if not exists runs (
+            id integer primary key, name text, seed integer, dir text, argv text,
+            status text, returncode integer, attempts integer default 0,
+            started real, finished real, unique(name, seed));
+        create table if not exists files (
+            run_id integer, file text, columns text, primary key(run_id, file));
+        create table if not exists rows (
+            run_id integer, file text, line integer, data text);
+        create index if not exists rows_file on rows(file, run_id);
+        """)
+    return db
+
+
+def read_datafile(path):
+    """Returns the column names and data rows of a datafile."""
+    columns = []
+    data = []
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            if line.startswith("#"):
+                columns.extend(line[1:].split())
+                continue
+            values = []
+            for v in line.split():
+                try:
+                    values.append(float(v))
+                except ValueError:
+                    values.append(v)
+            data.append(values)
+    return columns, data
+
+
+def backup_datafiles(run_dir):
+    """Moves a run's *.dat files to pre_resume/<n>, before it is resumed (which
+    truncates them)."""
+    files = glob.glob(os.path.join(run_dir, "*.dat"))
+    if not files:
+        return
+    d = os.path.join(run_dir, PRE_RESUME, str(len(glob.glob(os.path.join(run_dir, PRE_RESUME, "*")))))
+    os.makedirs(d)
+    for path in files:
+        shutil.move(path, d)
+
+
+def merge(segments):
+    """Concatenates the rows of a datafile written by successive attempts of a
+    run.  A resumed run rewrites the rows that follow its checkpoint, so rows of
+    an earlier attempt are dropped from the first update (the first column) of
+    the next attempt on."""
+    data = []
+    for rows in segments:
+        if data and rows and isinstance(rows[0][0], float):
+            data = [r for r in data if not (isinstance(r[0], float) and r[0] >= rows[0][0])]
+        data.extend(rows)
+    return data
+
+
+def collect(db, run_id, run_dir):
+    """Loads the datafiles of a finished run into the database, including those
+    saved by backup_datafiles before each time it was resumed."""
+    db.execute("delete from files where run_id=?", (run_id,))
+    db.execute("delete from rows where run_id=?", (run_id,))
+    dirs = sorted(glob.glob(os.path.join(run_dir, PRE_RESUME, "*")), key=lambda d: int(os.path.basename(d)))
+    dirs.append(run_dir)
+    names = sorted(set(os.path.basename(p) for d in dirs for p in glob.glob(os.path.join(d, "*.dat"))))
+    for name in names:
+        columns = []
+        segments = []
+        for d in dirs:
+            path = os.path.join(d, name)
+            if os.path.exists(path):
+                columns, rows = read_datafile(path)
+                segments.append(rows)
+        data = merge(segments)
+        db.execute("insert into files values (?,?,?)", (run_id, name, json.dumps(columns)))
+        db.executemany("insert into rows values (?,?,?,?)",
+                       [(run_id, name, i, json.dumps(v)) for i, v in enumerate(data)])
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("expr", help="experiment directory, containing run_list")
+    ap.add_argument("--out", help="output directory (default: var/<expr>)")
+    ap.add_argument("--jobs", type=int, default=os.cpu_count(),
+                    help="maximum concurrent runs (default: number of cores)")
+    ap.add_argument("--mem", type=float,
+                    help="per-run memory limit in GB (default: mem_request from run_list)")
+    ap.add_argument("--bin-dir", help="directory holding the executables")
+    ap.add_argument("--checkpoint-prefix", default="checkpoint",
+                    help="prefix of checkpoint files (ea.run.checkpoint_prefix)")
+    ap.add_argument("--resume-flag", default="--checkpoint",
+                    help="option used to restart a run from a checkpoint file")
+    ap.add_argument("--only", help="only run treatments matching this regex")
+    ap.add_argument("--dry-run", action="store_true", help="print the runs and exit")
+    args = ap.parse_args()
+
+    expr = os.path.normpath(args.expr)
+    settings, runs = parse_run_list(os.path.join(expr, "run_list"))
+    if args.only:
+        runs = [r for r in runs if re.search(args.only, r[0])]
+    out = args.out or os.path.join("var", os.path.basename(expr))
+    config_dir = os.path.join(expr, settings.get("config_dir", "config"))
+    mem = args.mem if args.mem is not None else float(settings.get("mem_request", 0) or 0)
+
+    slots = max(1, args.jobs)
+    if mem > 0:
+        slots = max(1, min(slots, int(available_memory_gb() // mem)))
+
+    if args.dry_run:
+        for name, seed, argv in runs:
+            print("%s/%d: %s" % (name, seed, " ".join(argv)))
+        print("%d runs, %d at a time" % (len(runs), slots))
+        return
+
+    os.makedirs(out, exist_ok=True)
+    db = open_db(os.path.join(out, "results.sqlite"))
+
+    pending = []
+    for name, seed, argv in runs:
+        run_dir = os.path.join(out, name, str(seed))
+        db.execute("insert or ignore into runs (name, seed, dir, argv, status) values (?,?,?,?,?)",
+                   (name, seed, run_dir, json.dumps(argv), "pending"))
+        row = db.execute("select id, status from runs where name=? and seed=?", (name, seed)).fetchone()
+        if row[1] != "done":
+            pending.append((row[0], name, seed, argv, run_dir, row[1]))
+    db.commit()
+    print("%d of %d runs to do, %d at a time" % (len(pending), len(runs), slots))
+
+    def limit():
+        os.setsid()
+        if mem > 0:
+            b = int(mem * 1024 ** 3)
+            resource.setrlimit(resource.RLIMIT_AS, (b, b))
+
+    def stop(signum, frame):
+        raise KeyboardInterrupt()
+    signal.signal(signal.SIGTERM, stop)
+
+    running = {}
+    try:
+        while pending or running:
+            while pending and len(running) < slots:
+                run_id, name, seed, argv, run_dir, status = pending.pop(0)
+                os.makedirs(run_dir, exist_ok=True)
+                if os.path.isdir(config_dir):
+                    for f in os.listdir(config_dir):
+                        shutil.copy(os.path.join(config_dir, f), run_dir)
+                argv = [locate(argv[0], args.bin_dir)] + argv[1:]
+                if status != "pending":
+                    cp = latest_checkpoint(run_dir, args.checkpoint_prefix)
+                    if cp is not None:
+                        backup_datafiles(run_dir)
+                        argv += [args.resume_flag, os.path.basename(cp)]
+                log = open(os.path.join(run_dir, "run.log"), "a")
+                try:
+                    p = subprocess.Popen(argv, cwd=run_dir, stdout=log, stderr=subprocess.STDOUT,
+                                         preexec_fn=limit)
+                except OSError as e:
+                    log.close()
+                    db.execute("update runs set status='failed', attempts=attempts+1 where id=?", (run_id,))
+                    db.commit()
+                    print("%s/%d failed to start: %s" % (name, seed, e))
+                    continue
+                running[p.pid] = (p, run_id, name, seed, run_dir, log)
+                db.execute("update runs set status='running', attempts=attempts+1, started=? where id=?",
+                           (time.time(), run_id))
+                db.commit()
+
+            if not running:
+                # nothing started (e.g., the rest failed to start):
+                continue
+            pid, rc = os.wait()
+            if pid not in running:
+                continue
+            p, run_id, name, seed, run_dir, log = running.pop(pid)
+            p.returncode = rc = os.waitstatus_to_exitcode(rc)
+            log.close()
+            status = "done" if rc == 0 else "failed"
+            if status == "done":
+                collect(db, run_id, run_dir)
+            db.execute("update runs set status=?, returncode=?, finished=? where id=?",
+                       (status, rc, time.time(), run_id))
+            db.commit()
+            print("%s/%d %s (%d)" % (name, seed, status, rc))
+    except KeyboardInterrupt:
+        # stop the runs; they resume from their checkpoints next time:
+        for p, run_id, name, seed, run_dir, log in running.values():
+            os.killpg(p.pid, signal.SIGTERM)
+        for p, run_id, name, seed, run_dir, log in running.values():
+            p.wait()
+            log.close()
+            db.execute("update runs set status='interrupted' where id=?", (run_id,))
+        db.commit()
+        print("interrupted; %d runs stopped" % len(running))
+        return 1
+
+    failed = db.execute("select count(*) from runs where status='failed'").fetchone()[0]
+    print("%d runs failed" % failed if failed else "all runs done")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,436 @@
+/* aggregate.cpp
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "statistics.h"
+#include "thread_pool.h"
+
+/* Summarizes the replicates of an experiment, as laid out by
+ scripts/run_local.py: <dir>/<treatment>/<seed>/<datafile>.
+
+ Usage: himalaya-aggregate <dir> [-j threads] [-o outdir] [-m column]... [datafile...]
+
+ For each treatment, writes <outdir>/<treatment>.summary (outdir defaults to
+ dir), with one row per (datafile, column, update):
+
+ file column update n mean ci95 q25 median q75 best_so_far
+
+ where the statistics are across seeds, and best_so_far is the mean over
+ seeds of the best value of the column so far.  Best is the running maximum,
+ except for columns named with -m (either as column or as file:column, e.g.,
+ -m fitness.dat:min_fitness), which are minimized and take the running
+ minimum.  Datafiles default to every *.dat file found in the first
+ replicate, and every file there that is a genome_log (e.g.,
+ dominant_archive.log); other files (e.g., run_local.py's run.log, and run
+ logs in run_log.bin) are skipped.  Text datafiles are whitespace-separated, with the update
+ in the first column; lines whose first token is not a number name the
+ columns.  Binary genome_log files are read as (update, w) rows.
+
+ Replicates need not record the same updates: at each update recorded by any
+ replicate, a replicate contributes the most recent row it has recorded, if
+ any.  Replicates are merged in a single streaming pass, with memory
+ proportional to the number of replicates, and (treatment, datafile) pairs
+ are summarized in parallel.  Files are read through mmap.
+ */
+
+//! Read-only memory mapping of a file.
+class mapped_file {
+public:
+    mapped_file(const std::string& path) : _p(0), _n(0) {
+        int fd=open(path.c_str(), O_RDONLY);
+        if(fd < 0) {
+            return;
+        }
+        struct stat st;
+        if((fstat(fd, &st) == 0) && (st.st_size > 0)) {
+            void* p=mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p != MAP_FAILED) {
+                _p = static_cast<const char*>(p);
+                _n = st.st_size;
+                madvise(p, _n, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+    }
+
+    ~mapped_file() {
+        if(_p != 0) {
+            munmap(const_cast<char*>(_p), _n);
+        }
+    }
+
+    const char* begin() const { return _p; }
+    const char* end() const { return _p + _n; }
+    bool ok() const { return _p != 0; }
+
+private:
+    mapped_file(const mapped_file&);
+    mapped_file& operator=(const mapped_file&);
+
+    const char* _p; //!< Mapped data.
+    std::size_t _n; //!< Size of the mapping.
+};
+
+/*! Sequential reader of rows from one replicate's datafile.
+ */
+class row_reader {
+public:
+    typedef std::vector<double> row_type;
+
+    row_reader(const std::string& path) : _f(path), _p(_f.begin()), _binary(false), _packed(false), _vsize(0) {
+        if(_f.ok() && ((_f.end() - _p) >= 12) && (std::memcmp(_p, "HGL2", 4) == 0)) {
+            _binary = true;
+            boost::uint32_t codec, v;
+            std::memcpy(&codec, _p+4, 4);
+            std::memcpy(&v, _p+8, 4);
+            _packed = (codec == 1);
+            _vsize = v;
+            _p += 12;
+            _columns.push_back("update");
+            _columns.push_back("w");
+        }
+    }
+
+    //! Returns the column names seen so far.
+    const std::vector<std::string>& columns() const { return _columns; }
+
+    //! Reads the next row into r, returning false at end of file.
+    bool next(row_type& r) {
+        return _binary ? next_binary(r) : next_text(r);
+    }
+
+protected:
+    bool next_text(row_type& r) {
+        while((_p != 0) && (_p < _f.end())) {
+            const char* eol=static_cast<const char*>(std::memchr(_p, '\n', _f.end() - _p));
+            if(eol == 0) {
+                eol = _f.end();
+            }
+            const char* q=_p;
+            _p = eol + 1;
+
+            r.clear();
+            bool header=false;
+            while(q < eol) {
+                while((q < eol) && ((*q == ' ') || (*q == '\t') || (*q == '\r') || (*q == '#'))) {
+                    header = header || (*q == '#');
+                    ++q;
+                }
+                const char* t=q;
+                while((q < eol) && (*q != ' ') && (*q != '\t') && (*q != '\r')) {
+                    ++q;
+                }
+                if(t == q) {
+                    break;
+                }
+                char buf[64];
+                std::size_t len=std::min(static_cast<std::size_t>(q - t), sizeof(buf)-1);
+                std::memcpy(buf, t, len);
+                buf[len] = 0;
+                char* e;
+                double v=std::strtod(buf, &e);
+                if(header || (*e != 0)) {
+                    header = true;
+                    _columns.push_back(buf);
+                } else {
+                    r.push_back(v);
+                }
+            }
+            if(!header && !r.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool next_binary(row_type& r) {
+        const std::size_t h=4+4+8+8;
+        if((_f.end() - _p) < static_cast<std::ptrdiff_t>(h)) {
+            return false;
+        }
+        boost::uint32_t kind, count;
+        boost::uint64_t update;
+        double w;
+        std::memcpy(&kind, _p, 4);
+        std::memcpy(&count, _p+4, 4);
+        std::memcpy(&update, _p+8, 8);
+        std::memcpy(&w, _p+16, 8);
+        if(_packed) {
+            _p += h + ((kind == 0) ? (((count + 63) / 64) * 8) : (count * 4));
+        } else {
+            _p += h + count * ((kind == 0) ? _vsize : (4 + _vsize));
+        }
+        r.assign(1, static_cast<double>(update));
+        r.push_back(w);
+        return true;
+    }
+
+    mapped_file _f; //!< Datafile.
+    const char* _p; //!< Read position.
+    bool _binary; //!< True for genome_log files.
+    bool _packed; //!< True if genomes are packed bitstrings (binary files).
+    std::size_t _vsize; //!< Size of genome values (binary files).
+    std::vector<std::string> _columns; //!< Column names.
+};
+
+//! Returns the two-sided 95% critical value of Student's t with df degrees of freedom.
+double t95(std::size_t df) {
+    static const double t[]={0.0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+        2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093,
+        2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    return (df < (sizeof(t)/sizeof(double))) ? t[df] : 1.960;
+}
+
+//! Returns the entries of directory d (excluding . and ..), sorted.
+std::vector<std::string> list_dir(const std::string& d, bool dirs) {
+    std::vector<std::string> r;
+    DIR* dp=opendir(d.c_str());
+    if(dp == 0) {
+        return r;
+    }
+    while(struct dirent* e=readdir(dp)) {
+        std::string n=e->d_name;
+        if((n == ".") || (n == "..")) {
+            continue;
+        }
+        struct stat st;
+        if((stat((d + "/" + n).c_str(), &st) == 0) && (S_ISDIR(st.st_mode) == dirs)) {
+            r.push_back(n);
+        }
+    }
+    closedir(dp);
+    std::sort(r.begin(), r.end());
+    return r;
+}
+
+//! Returns true if s ends with suffix.
+bool ends_with(const std::string& s, const std::string& suffix) {
+    return (s.size() >= suffix.size()) && (s.compare(s.size()-suffix.size(), suffix.size(), suffix) == 0);
+}
+
+//! Returns true if the file at path is a genome_log.
+bool is_genome_log(const std::string& path) {
+    char magic[4];
+    FILE* f=std::fopen(path.c_str(), "rb");
+    if(f == 0) {
+        return false;
+    }
+    bool r=(std::fread(magic, 1, 4, f) == 4) && (std::memcmp(magic, "HGL2", 4) == 0);
+    std::fclose(f);
+    return r;
+}
+
+//! Returns the name of column c, from the first replicate that names it.
+std::string column_name(const std::vector<std::shared_ptr<row_reader> >& readers, std::size_t c) {
+    for(std::size_t i=0; i<readers.size(); ++i) {
+        if(c < readers[i]->columns().size()) {
+            return readers[i]->columns()[c];
+        }
+    }
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "col%zu", c);
+    return buf;
+}
+
+/*! Merges the replicates of one datafile, and appends the summary rows to out.
+
+ Columns in minimize (by name, or by file:name) are summarized with the
+ running minimum as best_so_far.
+ */
+void summarize(const std::string& file, const std::vector<std::string>& paths,
+               const std::set<std::string>& minimize, std::string& out) {
+    std::size_t n=paths.size();
+    std::vector<std::shared_ptr<row_reader> > readers(n);
+    std::vector<row_reader::row_type> next(n), current(n), best(n);
+    std::vector<bool> has_next(n, false);
+    for(std::size_t i=0; i<n; ++i) {
+        readers[i].reset(new row_reader(paths[i]));
+        has_next[i] = readers[i]->next(next[i]);
+    }
+
+    // best values are kept as the running maximum of sign*value, where sign
+    // is -1 for minimized columns:
+    std::vector<double> sign;
+    std::vector<std::string> names;
+    statistics::sample x, b;
+    char buf[512];
+    while(true) {
+        // the next update is the smallest one at the head of any replicate:
+        double u=std::numeric_limits<double>::max();
+        for(std::size_t i=0; i<n; ++i) {
+            if(has_next[i]) {
+                u = std::min(u, next[i][0]);
+            }
+        }
+        if(u == std::numeric_limits<double>::max()) {
+            break;
+        }
+
+        // advance every replicate that recorded u, keeping the last row for u:
+        std::size_t ncols=0;
+        for(std::size_t i=0; i<n; ++i) {
+            while(has_next[i] && (next[i][0] == u)) {
+                current[i].swap(next[i]);
+                while(sign.size() < current[i].size()) {
+                    names.push_back(column_name(readers, sign.size()));
+                    bool m=minimize.count(names.back()) || minimize.count(file + ":" + names.back());
+                    sign.push_back(m ? -1.0 : 1.0);
+                }
+                if(best[i].size() < current[i].size()) {
+                    best[i].resize(current[i].size(), -std::numeric_limits<double>::max());
+                }
+                for(std::size_t c=0; c<current[i].size(); ++c) {
+                    best[i][c] = std::max(best[i][c], sign[c] * current[i][c]);
+                }
+                has_next[i] = readers[i]->next(next[i]);
+            }
+            ncols = std::max(ncols, current[i].size());
+        }
+
+        for(std::size_t c=1; c<ncols; ++c) {
+            x.clear();
+            b.clear();
+            for(std::size_t i=0; i<n; ++i) {
+                if(c < current[i].size()) {
+                    x.push_back(current[i][c]);
+                    b.push_back(sign[c] * best[i][c]);
+                }
+            }
+            if(x.empty()) {
+                continue;
+            }
+            statistics::summary s=x.summarize();
+            double ci=(s.n > 1) ? (t95(s.n-1) * std::sqrt(s.variance / s.n)) : 0.0;
+
+            std::snprintf(buf, sizeof(buf), "%s %s %.17g %zu %.10g %.10g %.10g %.10g %.10g %.10g\n",
+                          file.c_str(), names[c].c_str(), u, s.n, s.mean, ci,
+                          x.quantile(0.25), x.quantile(0.5), x.quantile(0.75), b.mean());
+            out += buf;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string dir, outdir;
+    std::size_t threads=0;
+    std::set<std::string> files, minimize;
+    for(int i=1; i<argc; ++i) {
+        std::string a=argv[i];
+        if((a == "-j") && ((i+1) < argc)) {
+            threads = std::max(1, std::atoi(argv[++i])) - 1;
+        } else if((a == "-o") && ((i+1) < argc)) {
+            outdir = argv[++i];
+        } else if((a == "-m") && ((i+1) < argc)) {
+            minimize.insert(argv[++i]);
+        } else if(dir.empty()) {
+            dir = a;
+        } else {
+            files.insert(a);
+        }
+    }
+    if(dir.empty()) {
+        std::fprintf(stderr, "usage: %s <dir> [-j threads] [-o outdir] [-m column]... [datafile...]\n", argv[0]);
+        return 1;
+    }
+    if(outdir.empty()) {
+        outdir = dir;
+    }
+
+    // one task per (treatment, datafile):
+    struct task {
+        std::string treatment;
+        std::string file;
+        std::vector<std::string> paths;
+    };
+    std::vector<task> tasks;
+    std::vector<std::string> treatments=list_dir(dir, true);
+    for(std::size_t t=0; t<treatments.size(); ++t) {
+        std::string tdir=dir + "/" + treatments[t];
+        std::vector<std::string> seeds=list_dir(tdir, true);
+        if(seeds.empty()) {
+            continue;
+        }
+        std::set<std::string> names=files;
+        if(names.empty()) {
+            std::string sdir=tdir + "/" + seeds[0];
+            std::vector<std::string> f=list_dir(sdir, false);
+            for(std::size_t i=0; i<f.size(); ++i) {
+                if(ends_with(f[i], ".dat") || is_genome_log(sdir + "/" + f[i])) {
+                    names.insert(f[i]);
+                }
+            }
+        }
+        for(std::set<std::string>::iterator i=names.begin(); i!=names.end(); ++i) {
+            task k;
+            k.treatment = treatments[t];
+            k.file = *i;
+            for(std::size_t s=0; s<seeds.size(); ++s) {
+                std::string p=tdir + "/" + seeds[s] + "/" + *i;
+                if(access(p.c_str(), R_OK) == 0) {
+                    k.paths.push_back(p);
+                }
+            }
+            if(!k.paths.empty()) {
+                tasks.push_back(k);
+            }
+        }
+    }
+
+    std::vector<std::string> results(tasks.size());
+    thread_pool pool(threads);
+    pool.parallel_for(tasks.size(), [&](std::size_t i) {
+        summarize(tasks[i].file, tasks[i].paths, minimize, results[i]);
+    });
+
+    // tasks are grouped by treatment, so each summary is written in one go:
+    for(std::size_t i=0; i<tasks.size(); ) {
+        std::string path=outdir + "/" + tasks[i].treatment + ".summary";
+        FILE* f=std::fopen(path.c_str(), "w");
+        if(f == 0) {
+            std::fprintf(stderr, "%s: could not write %s\n", argv[0], path.c_str());
+            return 1;
+        }
+        std::fprintf(f, "file column update n mean ci95 q25 median q75 best_so_far\n");
+        std::size_t j=i;
+        for( ; (j<tasks.size()) && (tasks[j].treatment == tasks[i].treatment); ++j) {
+            std::fwrite(results[j].data(), 1, results[j].size(), f);
+        }
+        std::fclose(f);
+        std::printf("%s: %zu datafiles, %zu replicates\n", path.c_str(), j-i, tasks[i].paths.size());
+        i = j;
+    }
+    return 0;
+}
@@ -0,0 +1,393 @@
+/* alps.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _ALPS_H_
+#define _ALPS_H_
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+
+#include <ea/metadata.h>
+#include <ea/datafile.h>
+
+#include "counter_rng.h"
+#include "evaluation.h"
+#include "order_statistics.h"
+#include "statistics.h"
+#include "thread_pool.h"
+
+using namespace ealib;
+
+LIBEA_MD_DECL(ALPS_LAYERS, "ea.meta_population.size", int);
+LIBEA_MD_DECL(ALPS_ADMISSION_AGING_SCHEME, "ea.alps.admission_aging_scheme", int);
+LIBEA_MD_DECL(ALPS_GAP_SIZE, "ea.alps.gap_size", int);
+LIBEA_MD_DECL(ALPS_REPLACEMENT_RATE, "ea.generational_model.replacement_rate.p", double);
+LIBEA_MD_DECL(ALPS_AGE, "individual.alps.age", int);
+LIBEA_MD_DECL(ALPS_LAYER, "individual.alps.layer", int);
+
+/*! Age-layered population structure (ALPS; Hornby, GECCO 2006).
+
+ The population is divided into ALPS_LAYERS layers of POPULATION_SIZE
+ individuals each.  An individual's age is the number of updates that its
+ oldest genetic material has been evolving; offspring take the age of their
+ oldest parent.  Layer l only admits individuals whose age is at most
+ ALPS_GAP_SIZE * scheme(l), where scheme is one of linear (0), Fibonacci (1),
+ polynomial (2), or exponential (3), and the top layer admits any age.
+ Every ALPS_GAP_SIZE updates, the bottom layer is restarted with random
+ individuals, each drawn from its own counter_rng stream, which are evaluated
+ in one batch before any layer breeds.
+
+ Ages are assigned at birth by alps_inheritance, which must be added as an
+ event.  Each update, each layer breeds ALPS_REPLACEMENT_RATE * POPULATION_SIZE
+ offspring from parents drawn from itself and the layer below.  Breeding
+ happens on the EA's thread, since the variation operators draw from
+ ea.rng().  Offspring from all layers are then evaluated together on
+ ASYNC_THREADS workers, after which each layer independently (and
+ concurrently) selects its survivors and the individuals it has outgrown.
+ Layers synchronize only to hand those individuals up to the next layer.
+
+ Each layer keeps its members ranked by fitness (weakest first, in the fitness
+ function's direction) in an indexed_skiplist (see order_statistics.h), which is updated as individuals join and leave the
+ layer rather than re-sorted.  Truncating a layer to POPULATION_SIZE removes
+ its weakest members one at a time, and an individual promoted into a full
+ layer is only admitted if it is fitter than the weakest member, which is
+ found in O(1).
+
+ Each layer's storage is allocated once, on the first update, with room for
+ its members, its offspring and the individuals promoted into it.
+
+ The EA's population is the union of all layers, and each individual records
+ its layer in ALPS_LAYER, so that the layers can be rebuilt from a
+ checkpoint.
+ */
+template <typename ParentSelectionStrategy>
+struct alps {
+    typedef ParentSelectionStrategy parent_selection_type;
+
+    //! Returns the maximum age admitted to layer l of n.
+    template <typename EA>
+    static int age_limit(std::size_t l, std::size_t n, EA& ea) {
+        if(l >= (n-1)) {
+            return std::numeric_limits<int>::max();
+        }
+        int s=1;
+        switch(get<ALPS_ADMISSION_AGING_SCHEME>(ea)) {
+            case 0: { // linear
+                s = l+1;
+                break;
+            }
+            case 1: { // fibonacci
+                int a=1, b=2;
+                for(std::size_t i=0; i<l; ++i) {
+                    int c=a+b; a=b; b=c;
+                }
+                s = a;
+                break;
+            }
+            case 2: { // polynomial
+                s = (l < 2) ? (l+1) : (l*l);
+                break;
+            }
+            case 3: { // exponential
+                s = 1 << l;
+                break;
+            }
+            default: {
+                throw std::invalid_argument("alps: unknown admission aging scheme");
+            }
+        }
+        return get<ALPS_GAP_SIZE>(ea) * s;
+    }
+
+    //! Apply this generational model to the population.
+    template <typename Population, typename EA>
+    void operator()(Population& population, EA& ea) {
+        typedef typename EA::individual_ptr_type individual_ptr_type;
+
+        if(!_state) {
+            initialize(population, ea);
+        }
+        state<Population>& s=*std::static_pointer_cast<state<Population> >(_state);
+        std::vector<layer<Population> >& layers=s.layers;
+        Population& batch=s.batch;
+        const std::size_t capacity=get<POPULATION_SIZE>(ea);
+
+        // restart the bottom layer; its members try to move up:
+        batch.clear();
+        bool restarted=false;
+        if((ea.current_update() > 0) && ((ea.current_update() % get<ALPS_GAP_SIZE>(ea)) == 0)) {
+            layer<Population>& l0=layers[0];
+            if(layers.size() > 1) {
+                layers[1].promoted.insert(layers[1].promoted.end(), l0.members.begin(), l0.members.end());
+            }
+            l0.members.clear();
+            l0.ranking.clear();
+            restarted = true;
+            for(std::size_t i=0; i<capacity; ++i) {
+                individual_ptr_type p=ea.make_individual();
+                counter_rng rng=rng_stream(i, counter_rng::ALPS_RESEED, ea);
+                random_genome(p->genome(), rng, ea);
+                put<IND_GENERATION>(0.0, *p);
+                put<ALPS_AGE>(0, *p);
+                l0.members.push_back(p);
+            }
+            // evaluate them now, as layer 0 is about to breed from them:
+            evaluate_batch(l0.members.begin(), l0.members.end(), *_pool, ea);
+        }
+
+        // breed each layer from itself and the layer below:
+        std::size_t n=std::max(1, static_cast<int>(get<ALPS_REPLACEMENT_RATE>(ea) * capacity));
+        for(std::size_t i=0; i<layers.size(); ++i) {
+            layer<Population>& l=layers[i];
+            l.offspring.clear();
+            l.parents.assign(l.members.begin(), l.members.end());
+            if(i > 0) {
+                l.parents.insert(l.parents.end(), layers[i-1].members.begin(), layers[i-1].members.end());
+            }
+            if(l.parents.size() < 2) {
+                continue;
+            }
+            recombine_n(l.parents, l.offspring,
+                        parent_selection_type(n, l.parents, ea),
+                        typename EA::recombination_operator_type(),
+                        n, ea);
+            mutate(l.offspring.begin(), l.offspring.end(), ea);
+            batch.insert(batch.end(), l.offspring.begin(), l.offspring.end());
+        }
+
+        // evaluate all offspring at once:
+        evaluate_batch(batch.begin(), batch.end(), *_pool, ea);
+
+        // each layer selects survivors and finds those that are too old, concurrently:
+        _pool->parallel_for(layers.size(), [&](std::size_t i) {
+            layer<Population>& l=layers[i];
+            if(restarted && (i == 0)) {
+                rank(l.members.begin(), l.members.end(), l.ranking, ea);
+            }
+            rank(l.offspring.begin(), l.offspring.end(), l.ranking, ea);
+            l.members.insert(l.members.end(), l.offspring.begin(), l.offspring.end());
+            l.outgrown.clear();
+            int limit=age_limit(i, layers.size(), ea);
+            for(typename Population::iterator j=l.members.begin(); j!=l.members.end(); ++j) {
+                if(get<ALPS_AGE>(**j) > limit) {
+                    l.ranking.erase(key(*j, ea));
+                    l.outgrown.push_back(*j);
+                }
+            }
+            truncate(l, capacity);
+        });
+
+        // synchronize: move outgrown individuals up, where they replace the weakest:
+        for(std::size_t i=0; i<layers.size(); ++i) {
+            layer<Population>& l=layers[i];
+            if(!l.promoted.empty()) {
+                for(typename Population::iterator j=l.promoted.begin(); j!=l.promoted.end(); ++j) {
+                    admit(l, *j, capacity, ea);
+                }
+                l.promoted.clear();
+                truncate(l, capacity);
+            }
+            if((i+1) < layers.size()) {
+                layers[i+1].promoted.insert(layers[i+1].promoted.end(), l.outgrown.begin(), l.outgrown.end());
+            }
+        }
+
+        // everyone gets older, and the population is the union of the layers:
+        population.clear();
+        for(std::size_t i=0; i<layers.size(); ++i) {
+            layer<Population>& l=layers[i];
+            for(typename Population::iterator j=l.members.begin(); j!=l.members.end(); ++j) {
+                put<ALPS_AGE>(get<ALPS_AGE>(**j) + 1, **j);
+                put<ALPS_LAYER>(static_cast<int>(i), **j);
+            }
+            population.insert(population.end(), l.members.begin(), l.members.end());
+        }
+    }
+
+protected:
+    //! Ranking key of an individual: its fitness, oriented so that larger is better, with ties broken by name.
+    typedef std::pair<double,long> key_type;
+
+    //! Returns fitness w oriented so that larger is better.
+    static double oriented(double w, maximizeS) { return w; }
+    static double oriented(double w, minimizeS) { return -w; }
+
+    //! Returns the ranking key of individual p.
+    template <typename IndividualPtr, typename EA>
+    static key_type key(const IndividualPtr& p, EA& ea) {
+        return key_type(oriented(static_cast<double>(p->fitness()), typename EA::fitness_function_type::direction_tag()),
+                        static_cast<long>(p->name()));
+    }
+
+    //! A single age layer.
+    template <typename Population>
+    struct layer {
+        typedef indexed_skiplist<key_type, typename Population::value_type> ranking_type;
+
+        Population members; //!< Individuals in this layer.
+        ranking_type ranking; //!< Members, weakest first.
+        Population parents; //!< Scratch: candidate parents (this layer and the one below).
+        Population offspring; //!< Scratch: offspring bred this update.
+        Population outgrown; //!< Scratch: members too old for this layer.
+        Population promoted; //!< Scratch: individuals moving up from the layer below.
+    };
+
+    //! All of the layers, plus scratch space for the offspring to be evaluated.
+    template <typename Population>
+    struct state {
+        std::vector<layer<Population> > layers; //!< Age layers, youngest first.
+        Population batch; //!< Scratch: offspring to be evaluated.
+    };
+
+    //! Sets up the layers, either from scratch or from a checkpointed population.
+    template <typename Population, typename EA>
+    void initialize(Population& population, EA& ea) {
+        std::shared_ptr<state<Population> > s(new state<Population>());
+        const std::size_t nlayers=get<ALPS_LAYERS>(ea);
+        const std::size_t capacity=get<POPULATION_SIZE>(ea);
+        const std::size_t n=std::max(1, static_cast<int>(get<ALPS_REPLACEMENT_RATE>(ea) * capacity));
+        s->layers.resize(nlayers);
+        for(std::size_t i=0; i<nlayers; ++i) {
+            layer<Population>& l=s->layers[i];
+            l.members.reserve(2*capacity + n);
+            l.parents.reserve(2*capacity);
+            l.offspring.reserve(n);
+            l.outgrown.reserve(capacity + n);
+            l.promoted.reserve(2*capacity + n);
+        }
+        for(typename Population::iterator i=population.begin(); i!=population.end(); ++i) {
+            std::size_t l=std::min(static_cast<std::size_t>(get<ALPS_LAYER>(**i,0)), nlayers-1);
+            if(!exists<ALPS_AGE>(**i)) {
+                put<ALPS_AGE>(0, **i);
+            }
+            s->layers[l].members.push_back(*i);
+        }
+        evaluate_pending(population.begin(), population.end(), ea);
+        for(std::size_t i=0; i<nlayers; ++i) {
+            rank(s->layers[i].members.begin(), s->layers[i].members.end(), s->layers[i].ranking, ea);
+        }
+        s->batch.reserve(nlayers * (capacity + n));
+        population.reserve(nlayers * capacity);
+        _state = s;
+        _pool.reset(new thread_pool(get<ASYNC_THREADS>(ea,0)));
+    }
+
+    //! Adds the (evaluated) individuals in [f, l) to ranking r.
+    template <typename ForwardIterator, typename Ranking, typename EA>
+    static void rank(ForwardIterator f, ForwardIterator l, Ranking& r, EA& ea) {
+        for( ; f!=l; ++f) {
+            r.insert(key(*f, ea), *f);
+        }
+    }
+
+    //! Adds p to layer l, unless l is full and p is no fitter than its weakest member.
+    template <typename Population, typename IndividualPtr, typename EA>
+    static void admit(layer<Population>& l, const IndividualPtr& p, std::size_t n, EA& ea) {
+        key_type k=key(p, ea);
+        if((l.ranking.size() >= n) && !(l.ranking.front().first < k)) {
+            return;
+        }
+        l.ranking.insert(k, p);
+        if(l.ranking.size() > n) {
+            l.ranking.pop_front();
+        }
+    }
+
+    //! Keeps the n fittest members of layer l, which are left weakest first.
+    template <typename Population>
+    static void truncate(layer<Population>& l, std::size_t n) {
+        while(l.ranking.size() > n) {
+            l.ranking.pop_front();
+        }
+        l.members.clear();
+        l.ranking.for_each([&l](const key_type&, const typename Population::value_type& p) { l.members.push_back(p); });
+    }
+
+    std::shared_ptr<void> _state; //!< Age layers.
+    std::shared_ptr<thread_pool> _pool; //!< Evaluation and selection threads.
+};
+
+/*! Offspring take the age of their oldest parent.
+
+ This handler (see static_events.h) must be added to any EA that uses alps.
+ */
+template <typename EA>
+struct alps_inheritance {
+    alps_inheritance(EA& ea) {
+    }
+
+    void inheritance(typename EA::population_type& parents,
+                     typename EA::individual_type& offspring,
+                     EA& ea) {
+        int age=0;
+        for(typename EA::population_type::iterator i=parents.begin(); i!=parents.end(); ++i) {
+            age = std::max(age, get<ALPS_AGE>(**i,0));
+        }
+        put<ALPS_AGE>(age, offspring);
+    }
+};
+
+/*! Datafile for the size, maximum fitness, and mean age of each ALPS layer.
+ */
+template <typename EA>
+struct alps_datafile {
+    alps_datafile(EA& ea) : _df("alps.dat") {
+        _df.add_field("update");
+        for(int i=0; i<get<ALPS_LAYERS>(ea); ++i) {
+            std::string l=boost::lexical_cast<std::string>(i);
+            _df.add_field("layer" + l + "_size")
+            .add_field("layer" + l + "_max_fitness")
+            .add_field("layer" + l + "_mean_age");
+        }
+    }
+
+    void record_statistics(EA& ea) {
+        std::size_t n=get<ALPS_LAYERS>(ea);
+        _w.resize(n);
+        _age.resize(n);
+        for(std::size_t l=0; l<n; ++l) {
+            _w[l].clear();
+            _age[l].clear();
+        }
+        for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
+            std::size_t l=get<ALPS_LAYER>(*i,0);
+            _w[l].push_back(static_cast<double>(i->fitness()));
+            _age[l].push_back(get<ALPS_AGE>(*i,0));
+        }
+
+        _df.write(ea.current_update());
+        for(std::size_t i=0; i<n; ++i) {
+            _df.write(_w[i].size())
+            .write(_w[i].max())
+            .write(_age[i].mean());
+        }
+        _df.endl();
+    }
+
+    std::vector<statistics::sample> _w; //!< Fitnesses in each layer.
+    std::vector<statistics::sample> _age; //!< Ages in each layer.
+    datafile _df;
+};
+
+#endif
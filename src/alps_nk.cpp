@@ -0,0 +1,90 @@
+/* alps_nk.cpp
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <ea/evolutionary_algorithm.h>
+#include <ea/genome_types/bitstring.h>
+#include <ea/fitness_functions/nk_model.h>
+#include <ea/selection/tournament.h>
+#include <ea/datafiles/evaluations.h>
+#include <ea/datafiles/fitness.h>
+#include <ea/cmdline_interface.h>
+using namespace ealib;
+
+#include "alps.h"
+#include "static_events.h"
+#include "packed_bitstring.h"
+
+typedef evolutionary_algorithm
+< direct<packed_bitstring>
+, nk_model< >
+, packed_per_site_bitflip
+, packed_two_point_crossover
+, alps<selection::tournament< > >
+, ancestors::random_bitstring
+> ea_type;
+
+//! Events dispatched without virtual calls (see static_events.h), in order.
+typedef static_events<alps_inheritance, alps_datafile> alps_events;
+
+
+/*! Define the EA's command-line interface.  Ealib provides an integrated command-line
+ and configuration file parser.  This class specializes that parser for this EA.
+ */
+template <typename EA>
+class cli : public cmdline_interface<EA> {
+public:
+    //! Define the options that can be parsed.
+    virtual void gather_options() {
+        add_option<REPRESENTATION_SIZE>(this);
+        add_option<POPULATION_SIZE>(this);
+        
+        add_option<ALPS_LAYERS>(this);
+        add_option<ALPS_ADMISSION_AGING_SCHEME>(this);
+        add_option<ALPS_GAP_SIZE>(this);
+        add_option<ALPS_REPLACEMENT_RATE>(this);
+        add_option<TOURNAMENT_SELECTION_N>(this);
+        add_option<TOURNAMENT_SELECTION_K>(this);
+        add_option<ASYNC_THREADS>(this);
+        
+        add_option<MUTATION_PER_SITE_P>(this);
+        
+        add_option<RUN_UPDATES>(this);
+        add_option<RUN_EPOCHS>(this);
+        add_option<CHECKPOINT_OFF>(this);
+        add_option<CHECKPOINT_PREFIX>(this);
+        add_option<RNG_SEED>(this);
+        add_option<RECORDING_PERIOD>(this);
+        
+        add_option<FF_RNG_SEED>(this);
+        add_option<NK_MODEL_N>(this);
+        add_option<NK_MODEL_K>(this);
+    }
+    
+    //! Define events (e.g., datafiles) here.
+    virtual void gather_events(EA& ea) {
+        add_event<datafiles::fitness_dat>(ea);
+        add_event<datafiles::fitness_evaluations>(ea);
+        add_event<alps_events::type>(ea);
+    };
+    
+    virtual void gather_tools() {
+    }
+};
+
+LIBEA_CMDLINE_INSTANCE(ea_type, cli);
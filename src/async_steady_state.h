@@ -0,0 +1,209 @@
+/* async_steady_state.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _ASYNC_STEADY_STATE_H_
+#define _ASYNC_STEADY_STATE_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ea/metadata.h>
+#include <ea/generational_models/steady_state.h>
+
+#include "evaluation.h"
+#include "thread_pool.h"
+
+using namespace ealib;
+
+LIBEA_MD_DECL(ASYNC_OVERLAP, "async.overlap", int);
+LIBEA_MD_DECL(ASYNC_DETERMINISTIC, "async.deterministic", int);
+//! If set, the minimum number of offspring bred per evaluating thread each update (default 0: STEADY_STATE_LAMBDA).
+LIBEA_MD_DECL(ASYNC_LAMBDA_PER_THREAD, "async.lambda_per_thread", int);
+
+/*! Offspring that have been bred, and are being (or have been) evaluated.
+ */
+template <typename Population>
+struct offspring_batch {
+    Population offspring; //!< Offspring, in the order they were bred.
+    std::vector<double> w; //!< Fitness of each offspring, filled in by the workers.
+    thread_pool::job_ptr job; //!< Evaluation job.
+    std::deque<std::size_t> finished; //!< Indices of evaluated offspring, in completion order.
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+/*! Returns the number of offspring to breed from a population of the given
+ size: STEADY_STATE_LAMBDA, or, if ASYNC_LAMBDA_PER_THREAD is set and there
+ are ASYNC_THREADS workers, enough to give each of them (and the EA's thread)
+ that many offspring to evaluate, but no more than half the population.
+ */
+template <typename EA>
+std::size_t async_lambda(std::size_t size, EA& ea) {
+    std::size_t n=get<STEADY_STATE_LAMBDA>(ea);
+    std::size_t t=get<ASYNC_THREADS>(ea,0);
+    std::size_t per=static_cast<std::size_t>(std::max(get<ASYNC_LAMBDA_PER_THREAD>(ea,0), 0));
+    if((t > 0) && (per > 0)) {
+        std::size_t m=per * (t + 1);
+        n = std::max(n, std::min(m, size / 2));
+    }
+    return n;
+}
+
+/*! Steady-state generational model that evaluates offspring on worker threads.
+
+ Each update, STEADY_STATE_LAMBDA offspring (see async_lambda()) are bred on
+ the EA's thread (which owns ea.rng()), evaluated by the ASYNC_THREADS
+ workers of evaluation_pool() (see evaluation.h), and then replace as many
+ individuals as are not kept by the survivor selection strategy.  Workers
+ only ever touch the offspring they are evaluating; the population itself is
+ only modified on the EA's thread, so replacement needs no locking.
+
+ Only evaluation is parallel: selection, recombination and mutation draw from
+ ea.rng(), and so stay on the EA's thread, and replacement happens a batch at
+ a time.  A batch of lambda offspring keeps at most lambda threads busy;
+ setting ASYNC_LAMBDA_PER_THREAD raises lambda to at least that many
+ offspring for each thread that evaluates (the workers and the EA's thread),
+ at the cost of making turnover, and so results, depend on the number of
+ threads (see async_lambda()).  Breeding and replacement are serial, and so
+ bound the speedup when evaluation is cheap.
+
+ With ASYNC_OVERLAP set, the offspring bred during update t are evaluated
+ while the rest of update t runs (events, datafiles, and breeding the next
+ batch), and replace individuals at update t+1.  Their parents are thus one
+ update stale.  They are listed in inflight_offspring() until they replace
+ individuals, so that their lines of descent are not truncated under them.
+
+ With ASYNC_DETERMINISTIC set (the default), offspring are committed in the
+ order they were bred, so a run is reproducible regardless of the number of
+ threads (unless ASYNC_LAMBDA_PER_THREAD is set).
+ Otherwise they are committed in the order their evaluations finish, and
+ fitness_evaluated handlers run while other evaluations are still in flight.
+
+ Pending individuals (e.g., lazily evaluated immigrants; see lazy.h) are
+ evaluated in one batch before parents are selected.  Every pending
+ individual is thus evaluated within an update of its birth, so
+ LAZY_EVALUATION saves no evaluations here (it only batches them); it pays off
+ with lazy_steady_state, which can replace individuals that are still pending.
+
+ With zero threads (the default), this is equivalent to steady_state.
+ */
+template <typename ParentSelectionStrategy, typename SurvivorSelectionStrategy>
+struct async_steady_state {
+    typedef ParentSelectionStrategy parent_selection_type;
+    typedef SurvivorSelectionStrategy survivor_selection_type;
+
+    //! Destructor; waits for any in-flight evaluations.
+    ~async_steady_state() {
+        if(_wait) {
+            _wait();
+        }
+    }
+
+    //! Apply this generational model to the population.
+    template <typename Population, typename EA>
+    void operator()(Population& population, EA& ea) {
+        typedef offspring_batch<Population> batch_type;
+        typedef std::shared_ptr<batch_type> batch_ptr;
+
+        batch_ptr b=breed(population, ea);
+        if(get<ASYNC_OVERLAP>(ea,0)) {
+            batch_ptr prev=std::static_pointer_cast<batch_type>(_inflight);
+            Population* roots=&inflight_offspring(ea);
+            *roots = b->offspring;
+            _inflight = b;
+            _wait = [b,roots]() { b->job->wait(); roots->clear(); };
+            if(!prev) {
+                return;
+            }
+            b = prev;
+        }
+        replace(*b, population, ea);
+    }
+
+    //! Breed offspring from the population, and start evaluating them.
+    template <typename Population, typename EA>
+    std::shared_ptr<offspring_batch<Population> > breed(Population& population, EA& ea) {
+        std::shared_ptr<offspring_batch<Population> > b(new offspring_batch<Population>());
+        std::size_t n=async_lambda(population.size(), ea);
+        evaluate_pending(population.begin(), population.end(), ea);
+        recombine_n(population, b->offspring,
+                    parent_selection_type(n, population, ea),
+                    typename EA::recombination_operator_type(),
+                    n, ea);
+        mutate(b->offspring.begin(), b->offspring.end(), ea);
+        b->w.resize(b->offspring.size());
+
+        offspring_batch<Population>* p=b.get();
+        bool ordered=get<ASYNC_DETERMINISTIC>(ea,1);
+        b->job = evaluation_pool(ea).submit(p->offspring.size(), [p,ordered,&ea](std::size_t i) {
+            p->w[i] = evaluate(*p->offspring[i], ea);
+            if(!ordered) {
+                std::lock_guard<std::mutex> lock(p->mutex);
+                p->finished.push_back(i);
+                p->cv.notify_one();
+            }
+        });
+        return b;
+    }
+
+    //! Commit the fitness of a batch of offspring, and add them to the population.
+    template <typename Population, typename EA>
+    void replace(offspring_batch<Population>& b, Population& population, EA& ea) {
+        std::size_t n=b.offspring.size();
+        if(get<ASYNC_DETERMINISTIC>(ea,1) || (evaluation_pool(ea).size() == 0)) {
+            b.job->wait();
+            for(std::size_t i=0; i<n; ++i) {
+                commit_fitness(*b.offspring[i], b.w[i], ea);
+            }
+        } else {
+            for(std::size_t k=0; k<n; ++k) {
+                std::size_t i;
+                {
+                    std::unique_lock<std::mutex> lock(b.mutex);
+                    while(b.finished.empty()) {
+                        b.cv.wait(lock);
+                    }
+                    i = b.finished.front();
+                    b.finished.pop_front();
+                }
+                commit_fitness(*b.offspring[i], b.w[i], ea);
+            }
+        }
+
+        // keep all but n individuals, and replace them with the offspring:
+        Population survivors;
+        if(population.size() > n) {
+            std::size_t m=population.size() - n;
+            survivor_selection_type sss(m, population, ea);
+            sss(population, survivors, m, ea);
+        }
+        survivors.insert(survivors.end(), b.offspring.begin(), b.offspring.end());
+        std::swap(population, survivors);
+    }
+
+    std::shared_ptr<void> _inflight; //!< Batch being evaluated across updates (ASYNC_OVERLAP).
+    std::function<void()> _wait; //!< Waits for the in-flight batch.
+};
+
+#endif
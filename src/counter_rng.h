@@ -0,0 +1,199 @@
+/* counter_rng.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _COUNTER_RNG_H_
+#define _COUNTER_RNG_H_
+
+#include <cmath>
+#include <boost/cstdint.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/split_member.hpp>
+
+#include <ea/metadata.h>
+
+using namespace ealib;
+
+/*! Philox4x32-10 block function (Salmon et al., SC 2011).
+
+ Encrypts the 128-bit counter c under the 64-bit key k, and writes the
+ result to out.  There is no state: the same (c, k) always gives the same
+ output.
+ */
+inline void philox4x32(const boost::uint32_t c[4], const boost::uint32_t k[2], boost::uint32_t out[4]) {
+    const boost::uint64_t M0=0xD2511F53, M1=0xCD9E8D57;
+    const boost::uint32_t W0=0x9E3779B9, W1=0xBB67AE85;
+    boost::uint32_t x0=c[0], x1=c[1], x2=c[2], x3=c[3];
+    boost::uint32_t k0=k[0], k1=k[1];
+    for(int r=0; r<10; ++r) {
+        boost::uint64_t p0=M0 * x0;
+        boost::uint64_t p1=M1 * x2;
+        boost::uint32_t y0=static_cast<boost::uint32_t>(p1 >> 32) ^ x1 ^ k0;
+        boost::uint32_t y1=static_cast<boost::uint32_t>(p1);
+        boost::uint32_t y2=static_cast<boost::uint32_t>(p0 >> 32) ^ x3 ^ k1;
+        boost::uint32_t y3=static_cast<boost::uint32_t>(p0);
+        x0 = y0; x1 = y1; x2 = y2; x3 = y3;
+        k0 += W0; k1 += W1;
+    }
+    out[0] = x0; out[1] = x1; out[2] = x2; out[3] = x3;
+}
+
+/*! Counter-based random number stream.
+
+ A stream is identified by (seed, purpose, update, individual), and its i'th
+ block of four 32-bit values is philox4x32 of the counter (i, individual,
+ update) under the key (seed, purpose).  Streams are therefore independent
+ of each other and of the order in which they are used: the random numbers
+ given to, say, the 3rd immigrant at update 100 are the same no matter which
+ thread generates them or what else has been drawn.
+
+ The whole state is the stream identity plus a position, so checkpointing a
+ stream is cheap, and any stream can be recreated from scratch.  The
+ interface mirrors the parts of ealib's RNG used in this project.
+ */
+class counter_rng {
+public:
+    typedef boost::uint32_t result_type;
+
+    //! Purposes, used to keep streams for different tasks apart.
+    enum purpose { ANCESTOR=0, MUTATION=1, SELECTION=2, IMMIGRANT=3, ALPS_RESEED=4, QHFC_REFILL=5 };
+
+    //! Constructor.
+    counter_rng(boost::uint32_t seed=0, boost::uint32_t purpose=0,
+                boost::uint64_t update=0, boost::uint32_t individual=0)
+    : _seed(seed), _purpose(purpose), _update(update), _individual(individual), _position(0) {
+    }
+
+    //! Returns the next 32 random bits.
+    result_type operator()() {
+        if((_position & 0x03) == 0) {
+            block(_position >> 2, _buffer);
+        }
+        return _buffer[_position++ & 0x03];
+    }
+
+    //! Returns the next 64 random bits.
+    boost::uint64_t next64() {
+        boost::uint64_t lo=(*this)();
+        return lo | (static_cast<boost::uint64_t>((*this)()) << 32);
+    }
+
+    //! Returns a random integer in [0, n); for std::random_shuffle.
+    std::ptrdiff_t operator()(std::ptrdiff_t n) {
+        return static_cast<std::ptrdiff_t>(uniform_real(0.0, 1.0) * n);
+    }
+
+    //! Returns a random real in [min, max).
+    double uniform_real(double min, double max) {
+        return min + (max - min) * (static_cast<double>(next64() >> 11) * (1.0 / 9007199254740992.0));
+    }
+
+    //! Returns a random integer in [min, max).
+    template <typename T>
+    T uniform_integer(T min, T max) {
+        return min + static_cast<T>(uniform_real(0.0, 1.0) * static_cast<double>(max - min));
+    }
+
+    //! Returns true with probability prob.
+    bool p(double prob) {
+        return uniform_real(0.0, 1.0) < prob;
+    }
+
+    //! Returns a random bit.
+    bool bit() {
+        return (*this)() & 0x01;
+    }
+
+    /*! Fills [out, out+n) with the next n 32-bit values.
+
+     Whole blocks are generated directly into the output, with no dependency
+     between them, so the loop vectorizes.
+     */
+    void fill(result_type* out, std::size_t n) {
+        std::size_t i=0;
+        while((i < n) && (_position & 0x03)) {
+            out[i++] = (*this)();
+        }
+        for( ; (i+4)<=n; i+=4, _position+=4) {
+            block(_position >> 2, out+i);
+        }
+        for( ; i<n; ++i) {
+            out[i] = (*this)();
+        }
+    }
+
+    //! Returns the number of 32-bit values drawn from this stream.
+    boost::uint64_t position() const { return _position; }
+
+    //! Moves to the given position in the stream.
+    void seek(boost::uint64_t pos) {
+        _position = pos;
+        if(_position & 0x03) {
+            block(_position >> 2, _buffer);
+        }
+    }
+
+protected:
+    //! Computes block b of this stream.
+    void block(boost::uint64_t b, result_type* out) const {
+        boost::uint32_t c[4]={static_cast<boost::uint32_t>(b), static_cast<boost::uint32_t>(b >> 32) ^ _individual,
+            static_cast<boost::uint32_t>(_update), static_cast<boost::uint32_t>(_update >> 32)};
+        boost::uint32_t k[2]={_seed, _purpose};
+        philox4x32(c, k, out);
+    }
+
+    friend class boost::serialization::access;
+
+    //! Checkpoints store the stream identity and position; the buffer is recomputed.
+    template <class Archive>
+    void save(Archive& ar, const unsigned int version) const {
+        ar & boost::serialization::make_nvp("seed", _seed);
+        ar & boost::serialization::make_nvp("purpose", _purpose);
+        ar & boost::serialization::make_nvp("update", _update);
+        ar & boost::serialization::make_nvp("individual", _individual);
+        ar & boost::serialization::make_nvp("position", _position);
+    }
+
+    template <class Archive>
+    void load(Archive& ar, const unsigned int version) {
+        ar & boost::serialization::make_nvp("seed", _seed);
+        ar & boost::serialization::make_nvp("purpose", _purpose);
+        ar & boost::serialization::make_nvp("update", _update);
+        ar & boost::serialization::make_nvp("individual", _individual);
+        boost::uint64_t pos;
+        ar & boost::serialization::make_nvp("position", pos);
+        seek(pos);
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER();
+
+    boost::uint32_t _seed; //!< Run seed.
+    boost::uint32_t _purpose; //!< What this stream is for.
+    boost::uint64_t _update; //!< Update at which this stream is used.
+    boost::uint32_t _individual; //!< Individual (or slot) that this stream belongs to.
+    boost::uint64_t _position; //!< Number of values drawn.
+    result_type _buffer[4]; //!< Current block.
+};
+
+//! Returns the stream for the given individual (or slot) and purpose at the EA's current update.
+template <typename EA>
+counter_rng rng_stream(std::size_t individual, counter_rng::purpose p, EA& ea) {
+    return counter_rng(static_cast<boost::uint32_t>(get<RNG_SEED>(ea)), p,
+                       ea.current_update(), static_cast<boost::uint32_t>(individual));
+}
+
+#endif
@@ -0,0 +1,113 @@
+/* counting_allocator.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _COUNTING_ALLOCATOR_H_
+#define _COUNTING_ALLOCATOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <boost/cstdint.hpp>
+
+/* Live-byte counts of the containers owned by this project, and requests to
+ compact them (see memory.h, which reports the counts and makes the
+ requests).  Kept free of libea, so that tools that do not link it (e.g.,
+ himalaya-aggregate) can use counted containers.
+ */
+
+namespace memory {
+
+//! Components whose live bytes are counted by their allocators.
+enum component { GENOMES, ARCHIVE, BUFFERS, COUNTED };
+
+//! Returns the live-byte counter of component c.
+inline std::atomic<boost::int64_t>& counter(component c) {
+    static std::atomic<boost::int64_t> counters[COUNTED];
+    return counters[c];
+}
+
+//! Returns the number of live bytes allocated by component c.
+inline double live(component c) {
+    return static_cast<double>(counter(c).load(std::memory_order_relaxed));
+}
+
+/*! Allocator that counts the bytes it has outstanding against component C.
+
+ Counting is a relaxed atomic add per allocation and deallocation, so it is
+ safe to use from the evaluation threads.
+ */
+template <typename T, int C>
+struct counting_allocator {
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef counting_allocator<U,C> other;
+    };
+
+    counting_allocator() {
+    }
+
+    template <typename U>
+    counting_allocator(const counting_allocator<U,C>&) {
+    }
+
+    T* allocate(std::size_t n) {
+        T* p=static_cast<T*>(::operator new(n * sizeof(T)));
+        counter(static_cast<component>(C)).fetch_add(static_cast<boost::int64_t>(n * sizeof(T)), std::memory_order_relaxed);
+        return p;
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        counter(static_cast<component>(C)).fetch_sub(static_cast<boost::int64_t>(n * sizeof(T)), std::memory_order_relaxed);
+        ::operator delete(p);
+    }
+
+    template <typename U>
+    bool operator==(const counting_allocator<U,C>&) const { return true; }
+
+    template <typename U>
+    bool operator!=(const counting_allocator<U,C>&) const { return false; }
+};
+
+
+/*! Returns the current compaction epoch.
+
+ Owners of buffers that can be shrunk (e.g., genome_log's index) remember the
+ epoch at which they last compacted, and compact again when it has moved on;
+ see compaction_due().
+ */
+inline std::atomic<unsigned>& compaction_epoch() {
+    static std::atomic<unsigned> epoch(0);
+    return epoch;
+}
+
+//! Returns true (and updates last) if a compaction was requested since last.
+inline bool compaction_due(unsigned& last) {
+    unsigned e=compaction_epoch().load(std::memory_order_relaxed);
+    if(e == last) {
+        return false;
+    }
+    last = e;
+    return true;
+}
+
+} // memory
+
+#endif
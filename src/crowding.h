@@ -0,0 +1,137 @@
+/* crowding.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _CROWDING_H_
+#define _CROWDING_H_
+
+#include <limits>
+#include <vector>
+
+#include <ea/metadata.h>
+#include <ea/generational_models/steady_state.h>
+
+#include "delay.h"
+#include "evaluation.h"
+#include "spatial_index.h"
+
+using namespace ealib;
+
+//! If set, optional_crowding replaces by crowding instead of with its default generational model.
+LIBEA_MD_DECL(CROWDING_ENABLED, "crowding.enabled", int);
+
+/*! Steady-state generational model with crowding replacement.
+
+ Each update, STEADY_STATE_LAMBDA offspring are bred and evaluated (on
+ ASYNC_THREADS workers, in the shared evaluation_pool()).  Each offspring then competes with its nearest
+ neighbor in the population (Hamming distance for bitstrings, Euclidean for
+ realstrings), and replaces it if it is at least as fit.  Replacement thus
+ happens within niches, which keeps distinct peaks occupied.
+
+ Nearest neighbors are found with an index over the population (see
+ spatial_index.h), built once per update; replaced individuals are retired
+ from the index, and their replacements inserted, so that later offspring
+ compete with the updated population.
+ */
+template <typename ParentSelectionStrategy>
+struct crowding {
+    typedef ParentSelectionStrategy parent_selection_type;
+
+    //! Apply this generational model to the population.
+    template <typename Population, typename EA>
+    void operator()(Population& population, EA& ea) {
+        typedef typename nn_index<typename EA::genome_type>::type index_type;
+
+        std::size_t n=get<STEADY_STATE_LAMBDA>(ea);
+        Population offspring;
+        recombine_n(population, offspring,
+                    parent_selection_type(n, population, ea),
+                    typename EA::recombination_operator_type(),
+                    n, ea);
+        mutate(offspring.begin(), offspring.end(), ea);
+        evaluate_batch(offspring.begin(), offspring.end(), evaluation_pool(ea), ea);
+
+        // index the population; node i is population[i] until it is retired:
+        index_type index;
+        index.reserve(population.size() + offspring.size());
+        _slot.clear();
+        _alive.clear();
+        for(std::size_t i=0; i<population.size(); ++i) {
+            index.insert(population[i]->genome());
+            _slot.push_back(i);
+            _alive.push_back(true);
+        }
+
+        // retired individuals are kept until the end of the update, as the index still refers to their genomes:
+        Population retired;
+        for(std::size_t i=0; i<offspring.size(); ++i) {
+            std::size_t id;
+            if(index.nearest(offspring[i]->genome(), alive(_alive), id) == std::numeric_limits<double>::infinity()) {
+                continue;
+            }
+            std::size_t s=_slot[id];
+            if(!better(population[s]->fitness(), offspring[i]->fitness(), typename EA::fitness_function_type::direction_tag())) {
+                _alive[id] = false;
+                retired.push_back(population[s]);
+                population[s] = offspring[i];
+                index.insert(population[s]->genome());
+                _slot.push_back(s);
+                _alive.push_back(true);
+            }
+        }
+    }
+
+    //! Accepts nodes that have not been retired.
+    struct alive {
+        alive(const std::vector<bool>& a) : _a(a) {
+        }
+
+        bool operator()(std::size_t i) const {
+            return _a[i];
+        }
+
+        const std::vector<bool>& _a;
+    };
+
+    std::vector<std::size_t> _slot; //!< Population slot of each index node.
+    std::vector<bool> _alive; //!< Whether each index node is still in the population.
+};
+
+/*! Generational model that replaces by crowding (see above) if
+ CROWDING_ENABLED is set, and otherwise applies GenerationalModel, so that
+ crowding can be chosen per run from the config file.
+ */
+template <typename GenerationalModel, typename ParentSelectionStrategy>
+struct optional_crowding {
+    typedef typename GenerationalModel::parent_selection_type parent_selection_type;
+
+    //! Apply this generational model to the population.
+    template <typename Population, typename EA>
+    void operator()(Population& population, EA& ea) {
+        if(get<CROWDING_ENABLED>(ea,0)) {
+            _crowding(population, ea);
+        } else {
+            _model(population, ea);
+        }
+    }
+
+    GenerationalModel _model; //!< Default generational model.
+    crowding<ParentSelectionStrategy> _crowding; //!< Crowding replacement.
+};
+
+#endif
@@ -20,19 +20,32 @@
 #ifndef _DELAY_H_
 #define _DELAY_H_
 
-#include <boost/accumulators/accumulators.hpp>
-#include <boost/accumulators/statistics/stats.hpp>
-#include <boost/accumulators/statistics/mean.hpp>
-
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
 #include <ea/metadata.h>
 #include <ea/selection/elitism.h>
 
+#include "counter_rng.h"
+#include "counting_allocator.h"
+#include "evaluation.h"
+#include "genome_log.h"
+#include "lazy.h"
+#include "metrics.h"
+#include "spatial_index.h"
+#include "statistics.h"
+
 using namespace ealib;
 
 LIBEA_MD_DECL(DELAY_GENERATIONS, "delay.generations", int);
 LIBEA_MD_DECL(DELAY_W_REAL, "delay.w_real", double);
 LIBEA_MD_DECL(DELAY_W_EFF, "delay.w_eff", double);
 LIBEA_MD_DECL(DELAY_RANDOM_INSERT, "delay.random_insert", double);
+LIBEA_MD_DECL(DELAY_STATISTICS_EVERY_UPDATE, "delay.statistics_every_update", int);
+LIBEA_MD_DECL(DELAY_ARCHIVE_KEYFRAME, "delay.archive_keyframe", int);
+LIBEA_MD_DECL(DELAY_ELITISM_MIN_DISTANCE, "delay.elitism.min_distance", double);
 
 
 
@@ -69,28 +82,82 @@ typename EA::individual_ptr_type lod_parent(typename EA::individual_type& ind, E
     return ind.traits().lod_parent();
 }
 
+/*! Calls f(w) with the real fitness w of each of the first (up to) n
+ ancestors of ind, nearest first, and returns the number of ancestors visited.
+ */
+template <typename Individual, typename F, typename EA>
+inline int walk_ancestors(Individual& ind, const int n, F f, EA& ea) {
+    int i=0;
+    for(typename EA::individual_ptr_type p=lod_parent(ind,ea); (i<n) && (p!=0); p=lod_parent(*p,ea)) {
+        f(get<DELAY_W_REAL>(*p));
+        ++i;
+    }
+    return i;
+}
+
+/*! Visits p and up to N-1 of its ancestors; the recursion over N unrolls the
+ walk at compile time (see walk_ancestors).
+ */
+template <int N>
+struct ancestor_walk {
+    template <typename IndividualPtr, typename F, typename EA>
+    static int visit(IndividualPtr p, F& f, EA& ea) {
+        if(p == 0) {
+            return 0;
+        }
+        f(get<DELAY_W_REAL>(*p));
+        return 1 + ancestor_walk<N-1>::visit(lod_parent(*p,ea), f, ea);
+    }
+};
+
+//! Visits nothing; ends the recursion.
+template <>
+struct ancestor_walk<0> {
+    template <typename IndividualPtr, typename F, typename EA>
+    static int visit(IndividualPtr p, F& f, EA& ea) {
+        return 0;
+    }
+};
+
+/*! As walk_ancestors above, with the bound N fixed at compile time.
+ */
+template <int N, typename Individual, typename F, typename EA>
+inline int walk_ancestors(Individual& ind, F f, EA& ea) {
+    return ancestor_walk<N>::visit(lod_parent(ind,ea), f, ea);
+}
+
+/*! Walks the DELAY_GENERATIONS ancestors of ind (see walk_ancestors).
+
+ If D is not negative and DELAY_GENERATIONS is D, the walk takes D as a
+ template parameter, and is unrolled; any other depth takes the same walk
+ with a runtime bound.
+ */
+template <int D, typename Individual, typename F, typename EA>
+inline int delay_walk(Individual& ind, F f, EA& ea) {
+    const int d=get<DELAY_GENERATIONS>(ea);
+    if((D >= 0) && (d == D)) {
+        return walk_ancestors<(D > 0 ? D : 0)>(ind, f, ea);
+    }
+    return walk_ancestors(ind, d, f, ea);
+}
+
 /*! Delay the fitness of an individual based on the mean fitness along its
  lineage.
+
+ D, if not negative, is the expected DELAY_GENERATIONS (see delay_walk); this
+ holds for all the delays below.
  */
-template <typename FitnessFunction>
+template <typename FitnessFunction, int D=-1>
 struct mean_delay : public FitnessFunction {
     typedef FitnessFunction parent;
 
     //! Common mean delay method.
     template <typename Individual, typename EA>
     double delay(Individual& ind, EA& ea) {
-        using namespace boost::accumulators;
-        
-        accumulator_set<double, stats<tag::mean> > w;
-        w(get<DELAY_W_REAL>(ind));
-        
-        typename EA::individual_ptr_type p=lod_parent(ind,ea);
-        for(int n=0; (n<get<DELAY_GENERATIONS>(ea)) && (p!=0); ++n) {
-            w(get<DELAY_W_REAL>(*p));
-            p = lod_parent(*p,ea);
-        }
+        double w=get<DELAY_W_REAL>(ind);
+        int n=1 + delay_walk<D>(ind, [&w](double x) { w += x; }, ea);
         
-        double w1 = mean(w);
+        double w1 = w / static_cast<double>(n);
         put<DELAY_W_EFF>(w1,ind);
         return w1;
 
@@ -117,57 +184,66 @@ struct mean_delay : public FitnessFunction {
  For example, the effective fitness w_eff of individual i is the real fitness
  w_real of its n'th ancestor.
  */
-template <typename FitnessFunction>
+template <typename FitnessFunction, int D=-1>
 struct generation_delay : public FitnessFunction {
     typedef FitnessFunction parent;
     
     template <typename Individual, typename EA>
     double operator()(Individual& ind, EA& ea) {
-        typedef typename EA::individual_ptr_type individual_ptr_type;
-        
         double w = parent::operator()(ind,ea);
         put<DELAY_W_REAL>(w, ind);
         
-        if(get<IND_GENERATION>(ind) > 0) {
-            individual_ptr_type p=ind.traits().lod_parent();
-            for(int i=1; (i<=get<DELAY_GENERATIONS>(ea)) && (get<IND_GENERATION>(*p) >= 0); ++i) {
-                w = get<DELAY_W_REAL>(*p);
-                p = p->traits().lod_parent();
-            }
-        }
+        delay_walk<D>(ind, [&w](double x) { w = x; }, ea);
         
         put<DELAY_W_EFF>(w, ind);
         return w;
     }
 };
 
+//! Returns true if fitness x is better than y, in the direction of the fitness function's direction_tag.
+inline bool better(double x, double y, maximizeS) { return x > y; }
+inline bool better(double x, double y, minimizeS) { return x < y; }
+
+//! Returns a fitness that any other is better than.
+inline double worst(maximizeS) { return -std::numeric_limits<double>::max(); }
+inline double worst(minimizeS) { return std::numeric_limits<double>::max(); }
+
+//! Returns the real fitness of an evaluated individual: DELAY_W_REAL if it has one, otherwise its fitness.
+template <typename Individual>
+double real_fitness(Individual& ind) {
+    return exists<DELAY_W_REAL>(ind) ? get<DELAY_W_REAL>(ind) : static_cast<double>(ind.fitness());
+}
+
+//! Orders individual pointers from worst to best real fitness.
+template <typename EA>
+struct real_fitness_order {
+    typedef typename EA::individual_ptr_type individual_ptr_type;
+    bool operator()(const individual_ptr_type& a, const individual_ptr_type& b) const {
+        return better(real_fitness(*b), real_fitness(*a), typename EA::fitness_function_type::direction_tag());
+    }
+};
+
 /* Rewrite the fitness of an individual to be the max fitness of its DELAY_GENERATIONS
  ancestors.
  
  For example, w_eff of individual i is the max w_real of its n ancestors (itself
  included).
  */
-template <typename FitnessFunction>
+template <typename FitnessFunction, int D=-1>
 struct peak_delay : public FitnessFunction {
     typedef FitnessFunction parent;
     
-    //! Compare two fitnesses based on the direction_tag:
-    double best(double x, double y, minimizeS) { return std::min(x,y); }
-    double best(double x, double y, maximizeS) { return std::max(x,y); }
+    //! Returns the better of two fitnesses, based on the direction_tag.
+    template <typename DirectionTag>
+    static double best(double x, double y, DirectionTag t) { return better(y, x, t) ? y : x; }
     
     //! Calculate fitness.
     template <typename Individual, typename EA>
     double operator()(Individual& ind, EA& ea) {
-        typedef typename EA::individual_ptr_type individual_ptr_type;
-        
         double w = parent::operator()(ind,ea);
         put<DELAY_W_REAL>(w, ind);
         
-        individual_ptr_type p=ind.traits().lod_parent();
-        for(int i=1; (i<=get<DELAY_GENERATIONS>(ea)) && (get<IND_GENERATION>(*p) >= 0); ++i) {
-            w = best(w,get<DELAY_W_REAL>(*p),typename parent::direction_tag());
-            p = p->traits().lod_parent();
-        }
+        delay_walk<D>(ind, [&w](double x) { w = best(w, x, typename parent::direction_tag()); }, ea);
         
         put<DELAY_W_EFF>(w, ind);
         return w;
@@ -185,8 +261,14 @@ struct peak_delay : public FitnessFunction {
  of the source population from which the embedded selection strategy draws its
  own selected individuals.
  
- UPDATE: Keep the N highest-fit, most diverse individuals...
- 
+ If DELAY_ELITISM_MIN_DISTANCE is set, the elite are the N fittest
+ individuals (by real_fitness) that are at least that far from each other
+ (Hamming distance for bitstrings, Euclidean for realstrings), found with a
+ nearest-neighbor index over the elite chosen so far.  If too few individuals
+ are far enough apart, the rest of the elite are the fittest of those left.
+
+ Pending individuals (see lazy.h) are evaluated in one batch before the elite
+ are chosen.
  */
 template <typename SelectionStrategy>
 struct delayed_elitism {
@@ -207,11 +289,40 @@ struct delayed_elitism {
         
         // now, append the e most-fit individuals:
         if(e > 0) {
-            calculate_fitness(src.begin(), src.end(), ea);
-            std::sort(src.begin(), src.end(), comparators::metadata<DELAY_W_REAL,EA>());
-            typename Population::reverse_iterator rl=src.rbegin();
-            std::advance(rl, e);
-            dst.insert(dst.end(), src.rbegin(), rl);
+            evaluate_pending(src.begin(), src.end(), ea);
+            double r=get<DELAY_ELITISM_MIN_DISTANCE>(ea,0.0);
+            if(r <= 0.0) {
+                // only the e fittest need to be ordered:
+                e = std::min(e, src.size());
+                std::nth_element(src.begin(), src.end()-e, src.end(), real_fitness_order<EA>());
+                std::sort(src.end()-e, src.end(), real_fitness_order<EA>());
+                typename Population::reverse_iterator rl=src.rbegin();
+                std::advance(rl, e);
+                dst.insert(dst.end(), src.rbegin(), rl);
+                return;
+            }
+            
+            // greedily take the fittest individuals that are far enough from those already taken:
+            std::sort(src.begin(), src.end(), real_fitness_order<EA>());
+            typename nn_index<typename EA::genome_type>::type index;
+            index.reserve(e);
+            std::vector<bool> taken(src.size(), false);
+            std::size_t k=0;
+            for(std::size_t i=src.size(); (i>0) && (k<e); --i) {
+                std::size_t id;
+                if(index.nearest(src[i-1]->genome(), any_node(), id) >= r) {
+                    index.insert(src[i-1]->genome());
+                    dst.push_back(src[i-1]);
+                    taken[i-1] = true;
+                    ++k;
+                }
+            }
+            for(std::size_t i=src.size(); (i>0) && (k<e); --i) {
+                if(!taken[i-1]) {
+                    dst.push_back(src[i-1]);
+                    ++k;
+                }
+            }
         }
     };
     
@@ -219,74 +330,219 @@ struct delayed_elitism {
 };
 
 
-/*! At the end of each update, insert random individuals into the population.
+/*! At the end of each update, replace DELAY_RANDOM_INSERT*POPULATION_SIZE
+ individuals with random immigrants.
+ 
+ Victims are chosen at random from all but the ELITISM_N fittest individuals,
+ and the population size does not change.  Each immigrant is a new individual
+ (see make_individual), with a new name and no metadata, so nothing keyed by
+ name or stored in metadata (e.g., parent_quality records) carries over from
+ its victim; the victim's genome storage is recycled for it, unless something
+ else (e.g., a descendant's lineage) still refers to the victim.  Immigrants
+ have no parents, and are evaluated in one batch (in evaluation_pool()),
+ unless LAZY_EVALUATION is set, in which case they are left pending (see
+ lazy.h) and the elite are the fittest of the evaluated individuals; this
+ only saves evaluations if the generational model can replace them while
+ they are pending (lazy_steady_state can; async_steady_state cannot).
+ The i'th immigrant's genome is drawn from its own counter_rng stream, so it
+ does not depend on how many numbers the rest of the update drew.
  */
 template <typename EA>
-struct random_individuals : end_of_update_event<EA> {
-    random_individuals(EA& ea) : end_of_update_event<EA>(ea) {
+struct random_individuals {
+    typedef typename EA::individual_ptr_type individual_ptr_type;
+    typedef typename EA::population_type population_type;
+    
+    random_individuals(EA& ea) {
     }
     
-    virtual void operator()(EA& ea) {
-        generate_ancestors(typename EA::ancestor_generator_type(), get<DELAY_RANDOM_INSERT>(ea)*get<POPULATION_SIZE>(ea), ea);
+    void end_of_update(EA& ea) {
+        population_type& pop=ea.population();
+        std::size_t e=std::min(static_cast<std::size_t>(get<ELITISM_N>(ea,0)), pop.size());
+        std::size_t n=std::min(static_cast<std::size_t>(get<DELAY_RANDOM_INSERT>(ea)*get<POPULATION_SIZE>(ea)), pop.size()-e);
+        if(n == 0) {
+            return;
+        }
+        
+        // move the elite to the back, out of the way:
+        if(e > 0) {
+            std::nth_element(pop.begin(), pop.end()-e, pop.end(), pending_first());
+        }
+        
+        // choose n distinct victims from the front, and turn them into immigrants:
+        std::size_t m=pop.size() - e;
+        for(std::size_t i=0; i<n; ++i) {
+            std::swap(pop[i], pop[i + ea.rng().uniform_integer(0, static_cast<int>(m-i))]);
+            individual_ptr_type victim=pop[i];
+            pop[i] = ea.make_individual();
+            typename EA::individual_type& ind=*pop[i];
+            if(victim.use_count() == 1) {
+                // nothing else refers to the victim; recycle its genome's storage:
+                std::swap(ind.genome(), victim->genome());
+            }
+            counter_rng rng=rng_stream(i, counter_rng::IMMIGRANT, ea);
+            random_genome(ind.genome(), rng, ea);
+            put<IND_GENERATION>(0.0, ind);
+        }
+        
+        if(get<LAZY_EVALUATION>(ea,0)) {
+            return;
+        }
+        evaluate_batch(pop.begin(), pop.begin()+n, evaluation_pool(ea), ea);
     }
 };
 
 
 /*! Store the dominant individual (based on real fitness).
+ 
+ Each time an individual is evaluated whose real fitness is better than that
+ of the last dominant, its genome is appended to dominant_archive.log (see
+ genome_log), and a row is written to dominant_archive.dat.  Only an index of
+ the archive is held in memory; any archived genome can be recovered with
+ genome().  The index is compacted when memory_accounting asks for it.
  */
 template <typename EA>
-struct dominant_archive : fitness_evaluated_event<EA> {
-    dominant_archive(EA& ea) : fitness_evaluated_event<EA>(ea), _df("dominant_archive.dat") {
+struct dominant_archive {
+    dominant_archive(EA& ea)
+    : _archive("dominant_archive.log", get<DELAY_ARCHIVE_KEYFRAME>(ea,64))
+    , _epoch(memory::compaction_epoch())
+    , _df("dominant_archive.dat") {
         _df.add_field("update")
         .add_field("dominant_w_real");
     }
 
-    virtual void operator()(typename EA::individual_type& ind, EA& ea) {
-        if(_archive.empty()
-           || (get<DELAY_W_REAL>(ind) > get<DELAY_W_REAL>(*_archive.back()))) {
-            typename EA::individual_ptr_type p=ea.copy_individual(ind);
-            p->traits().lod_clear();
-            _archive.push_back(p);
-            _df.write(ea.current_update()).write(get<DELAY_W_REAL>(*p)).endl();
+    void fitness_evaluated(typename EA::individual_type& ind, EA& ea) {
+        if(memory::compaction_due(_epoch)) {
+            _archive.compact();
         }
+        double w=get<DELAY_W_REAL>(ind);
+        if(_archive.empty() || better(w, _archive.back().w, typename EA::fitness_function_type::direction_tag())) {
+            _archive.append(ind.genome(), ea.current_update(), w);
+            _df.write(ea.current_update()).write(w).endl();
+        }
+    }
+    
+    //! Returns the genome of the i'th archived dominant.
+    typename EA::genome_type genome(std::size_t i) {
+        return _archive.genome(i);
     }
-    typename EA::population_type _archive;
+    
+    genome_log<typename EA::genome_type> _archive;
+    unsigned _epoch; //!< Compaction epoch of _archive (see memory.h).
     datafile _df;
 };
 
-/*! Datafile for mean generation, and mean & max fitness.
+/*! Datafile for mean, max, min & variance of real fitness, and mean effective
+ fitness.
+ 
+ Rows are written every RECORDING_PERIOD updates, or every update if
+ DELAY_STATISTICS_EVERY_UPDATE is set.  Samples are gathered into buffers that
+ are reused from one row to the next.  Pending individuals are evaluated before
+ a row is written.
  */
 template <typename EA>
-struct effective_fitness : record_statistics_event<EA> {
-    effective_fitness(EA& ea) : record_statistics_event<EA>(ea), _df("effective_fitness.dat") {
+struct effective_fitness {
+    effective_fitness(EA& ea) : _df("effective_fitness.dat") {
         _df.add_field("update")
         .add_field("mean_w_real")
         .add_field("max_w_real")
-        .add_field("mean_w_eff");
+        .add_field("mean_w_eff")
+        .add_field("min_w_real")
+        .add_field("var_w_real");
     }
     
-    virtual ~effective_fitness() {
-    }
-    
-    virtual void operator()(EA& ea) {
-        using namespace boost::accumulators;
-        accumulator_set<double, stats<tag::mean,tag::max> > w_real;
-        accumulator_set<double, stats<tag::mean> > w_eff;
+    void end_of_update(EA& ea) {
+        if(!get<DELAY_STATISTICS_EVERY_UPDATE>(ea,0)
+           && ((ea.current_update() % get<RECORDING_PERIOD>(ea)) != 0)) {
+            return;
+        }
         
+        evaluate_pending(ea.population().begin(), ea.population().end(), ea);
+        _w_real.clear();
+        _w_eff.clear();
         for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
-            w_real(get<DELAY_W_REAL>(*i));
-            w_eff(get<DELAY_W_EFF>(*i));
+            _w_real.push_back(get<DELAY_W_REAL>(*i));
+            _w_eff.push_back(get<DELAY_W_EFF>(*i));
         }
         
+        statistics::summary w=_w_real.summarize();
         _df.write(ea.current_update())
-        .write(mean(w_real))
-        .write(max(w_real))
-        .write(mean(w_eff))
+        .write(w.mean)
+        .write(w.max)
+        .write(_w_eff.mean())
+        .write(w.min)
+        .write(w.variance)
         .endl();
     }
     
+    statistics::sample _w_real; //!< Real fitnesses of the current population.
+    statistics::sample _w_eff; //!< Effective fitnesses of the current population.
     datafile _df;
 };
 
 
+/*! Publishes live gauges through shared memory (see metrics.h): update,
+ evaluations, evaluations per second, mean and max real fitness, mean
+ effective fitness, and RSS (sampled every METRICS_RSS_PERIOD updates), once
+ per update.
+
+ Disabled unless METRICS_SHM is set.  Fitness gauges are over evaluated
+ individuals only, so that publishing them never forces an evaluation.
+ */
+template <typename EA>
+struct delay_metrics {
+    delay_metrics(EA& ea) : _rss(get<METRICS_RSS_PERIOD>(ea,64)) {
+        std::string name=get<METRICS_SHM>(ea, std::string());
+        if(name.empty()) {
+            return;
+        }
+        std::vector<std::string> fields;
+        fields.push_back("update");
+        fields.push_back("evaluations");
+        fields.push_back("evaluations_per_sec");
+        fields.push_back("mean_w_real");
+        fields.push_back("max_w_real");
+        fields.push_back("mean_w_eff");
+        fields.push_back("rss_bytes");
+        _values.resize(fields.size());
+        _evaluations.reset(new metrics::evaluation_counter<EA>(ea));
+        _writer.reset(new metrics::writer(name, fields, get<METRICS_KEEP>(ea,0)));
+    }
+
+    void fitness_evaluated(typename EA::individual_type& ind, EA& ea) {
+        if(_evaluations) {
+            _evaluations->fitness_evaluated(ind, ea);
+        }
+    }
+
+    void end_of_update(EA& ea) {
+        if(!_writer) {
+            return;
+        }
+        _w_real.clear();
+        _w_eff.clear();
+        for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
+            if(is_evaluated(*i)) {
+                _w_real.push_back(get<DELAY_W_REAL>(*i));
+                _w_eff.push_back(get<DELAY_W_EFF>(*i));
+            }
+        }
+        _values[0] = ea.current_update();
+        _values[1] = _evaluations->n;
+        _values[2] = _evaluations->rate();
+        _values[3] = _w_real.mean();
+        _values[4] = _w_real.empty() ? -std::numeric_limits<double>::max() : _w_real.max();
+        _values[5] = _w_eff.mean();
+        _values[6] = _rss();
+        _writer->write(&_values[0]);
+    }
+
+    std::shared_ptr<metrics::evaluation_counter<EA> > _evaluations; //!< Counts evaluations.
+    std::shared_ptr<metrics::writer> _writer; //!< Shared-memory writer.
+    std::vector<double> _values; //!< Record being written.
+    statistics::sample _w_real; //!< Real fitnesses of evaluated individuals.
+    statistics::sample _w_eff; //!< Effective fitnesses of evaluated individuals.
+    metrics::rss_sampler _rss; //!< Resident set size.
+};
+
+
 #endif
@@ -32,20 +32,62 @@ using namespace ealib;
 
 #include "delay.h"
 #include "analysis.h"
+#include "async_steady_state.h"
+#include "crowding.h"
+#include "lazy.h"
+#include "surrogate.h"
+#include "stopping.h"
+#include "memory.h"
+#include "lineage_lag.h"
+#include "run_log.h"
+#include "static_events.h"
+
+// build with HIMALAYA_LAZY defined to leave offspring unevaluated until selection needs them,
+// or with HIMALAYA_SURROGATE defined to evaluate only the offspring a surrogate ranks best:
+#if defined(HIMALAYA_LAZY)
+typedef lazy_steady_state<lazy_tournament> generational_model_type;
+#elif defined(HIMALAYA_SURROGATE)
+typedef surrogate_steady_state<selection::tournament< >, delayed_elitism<selection::random< > > > generational_model_type;
+#else
+// set crowding.enabled to replace by crowding instead (see crowding.h):
+typedef optional_crowding
+< async_steady_state<selection::tournament< >, delayed_elitism<selection::random< > > >
+, selection::tournament< >
+> generational_model_type;
+#endif
+
+// build with HIMALAYA_FIXED_SHAPE defined to specialize for 8 delay generations,
+// as in etc/delay.cfg; other depths still run, through the generic code:
+#ifdef HIMALAYA_FIXED_SHAPE
+const int delay_depth=8;
+#else
+const int delay_depth=-1;
+#endif
 
 typedef evolutionary_algorithm
 < direct<realstring>
-, generation_delay<benchmarks>
+, generation_delay<benchmarks, delay_depth>
 , mutation::operators::per_site<mutation::site::uniform_real>
 , recombination::two_point_crossover
-, generational_models::steady_state<selection::tournament< >, selection::elitism<selection::random< > > >
+, generational_model_type
 , ancestors::uniform_real
-, dont_stop
+, convergence_stop
 , fill_population
 , default_lifecycle
 , lod_trait
 > ea_type;
 
+//! Events dispatched without virtual calls (see static_events.h), in order.
+typedef static_events
+< effective_fitness
+, lineage_lag
+, dominant_archive
+, delay_metrics
+, stop_monitor
+, memory_accounting
+, run_recorder
+> delay_events;
+
 
 /*! Define the EA's command-line interface.  Ealib provides an integrated command-line
  and configuration file parser.  This class specializes that parser for this EA.
@@ -62,6 +104,14 @@ public:
         add_option<TOURNAMENT_SELECTION_N>(this);
         add_option<TOURNAMENT_SELECTION_K>(this);
         add_option<ELITISM_N>(this);
+        add_option<ASYNC_THREADS>(this);
+        add_option<ASYNC_OVERLAP>(this);
+        add_option<ASYNC_DETERMINISTIC>(this);
+        add_option<ASYNC_LAMBDA_PER_THREAD>(this);
+        add_option<CROWDING_ENABLED>(this);
+        add_option<SURROGATE_OVERSAMPLE>(this);
+        add_option<SURROGATE_ARCHIVE>(this);
+        add_option<SURROGATE_K>(this);
 
         add_option<MUTATION_PER_SITE_P>(this);
         add_option<MUTATION_UNIFORM_REAL_MIN>(this);
@@ -78,15 +128,29 @@ public:
         add_option<BENCHMARKS_FUNCTION>(this);
         
         add_option<DELAY_GENERATIONS>(this);
+        add_option<DELAY_STATISTICS_EVERY_UPDATE>(this);
+        add_option<DELAY_ARCHIVE_KEYFRAME>(this);
+        add_option<DELAY_ELITISM_MIN_DISTANCE>(this);
+        add_option<METRICS_SHM>(this);
+        add_option<METRICS_KEEP>(this);
+        add_option<METRICS_RSS_PERIOD>(this);
+        
+        add_option<STOP_TARGET_W>(this);
+        add_option<STOP_STAGNATION_WINDOW>(this);
+        add_option<STOP_EVALUATION_BUDGET>(this);
+        add_option<MEMORY_BUDGET>(this);
+        add_option<MEMORY_LOD_DEPTH>(this);
+        add_option<LINEAGE_TRUNCATE_LOD>(this);
+        add_option<RUN_LOG>(this);
     }
     
     //! Define events (e.g., datafiles) here.
     virtual void gather_events(EA& ea) {
+        add_event<static_events<lazy_flush>::type>(ea);
         add_event<datafiles::fitness_dat>(ea);
         add_event<datafiles::fitness_evaluations>(ea);
         add_event<lod_event>(ea);
-        add_event<effective_fitness>(ea);
-        add_event<dominant_archive>(ea);
+        add_event<delay_events::type>(ea);
     };
     
     virtual void gather_tools() {
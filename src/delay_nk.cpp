@@ -35,20 +35,83 @@ using namespace ealib;
 
 #include "delay.h"
 #include "analysis.h"
+#include "async_steady_state.h"
+#include "crowding.h"
+#include "lazy.h"
+#include "stopping.h"
+#include "memory.h"
+#include "interning.h"
+#include "lineage_lag.h"
+#include "run_log.h"
+#include "parent_quality.h"
+#include "static_events.h"
+#include "packed_bitstring.h"
+#include "hashed_nk_model.h"
+
+// build with HIMALAYA_HASHED_NK defined to use the table-free NK landscape:
+#ifdef HIMALAYA_HASHED_NK
+#include "neighborhood.h"
+#endif
+
+// build with HIMALAYA_FIXED_SHAPE defined to specialize for 8 delay generations,
+// as in etc/delay.cfg, and, with HIMALAYA_HASHED_NK, the hashed landscape for
+// N=32, K=8; libea's table nk_model, the default, is not specialized.  Other
+// shapes still run, through the generic code:
+#if defined(HIMALAYA_HASHED_NK) && defined(HIMALAYA_FIXED_SHAPE)
+typedef fixed_nk_model<32,8> nk_type;
+#elif defined(HIMALAYA_HASHED_NK)
+typedef hashed_nk_model nk_type;
+#else
+typedef nk_model< > nk_type;
+#endif
+
+#ifdef HIMALAYA_FIXED_SHAPE
+const int delay_depth=8;
+#else
+const int delay_depth=-1;
+#endif
+
+// build with HIMALAYA_LAZY defined to leave offspring unevaluated until selection needs them:
+#ifdef HIMALAYA_LAZY
+typedef lazy_steady_state<lazy_tournament> generational_model_type;
+#else
+// set crowding.enabled to replace by crowding instead (see crowding.h):
+typedef optional_crowding
+< async_steady_state<selection::tournament< >, delayed_elitism<selection::random< > > >
+, selection::tournament< >
+> generational_model_type;
+#endif
 
 typedef evolutionary_algorithm
-< direct<bitstring>
-, generation_delay<nk_model< > >
-, mutation::operators::per_site<mutation::site::uniform_real>
-, recombination::two_point_crossover
-, generational_models::steady_state<selection::tournament< >, selection::elitism<selection::random< > > >
+< direct<packed_bitstring>
+, generation_delay<nk_type, delay_depth>
+, heritable_mutation<packed_per_site_bitflip>
+, packed_two_point_crossover
+, generational_model_type
 , ancestors::random_bitstring
-, dont_stop
+, convergence_stop
 , fill_population
 , default_lifecycle
 , lod_trait
 > ea_type;
 
+//! Events dispatched without virtual calls (see static_events.h), in order.
+typedef static_events
+< genome_interning
+, effective_fitness
+, lineage_lag
+, dominant_archive
+, delay_metrics
+, stop_monitor
+, memory_accounting
+, parent_quality_tracker
+, random_individuals
+, run_recorder
+#ifdef HIMALAYA_HASHED_NK
+, landscape_position
+#endif
+> delay_events;
+
 
 /*! Define the EA's command-line interface.  Ealib provides an integrated command-line
  and configuration file parser.  This class specializes that parser for this EA.
@@ -64,6 +127,11 @@ public:
         add_option<TOURNAMENT_SELECTION_N>(this);
         add_option<TOURNAMENT_SELECTION_K>(this);
         add_option<ELITISM_N>(this);
+        add_option<ASYNC_THREADS>(this);
+        add_option<ASYNC_OVERLAP>(this);
+        add_option<ASYNC_DETERMINISTIC>(this);
+        add_option<ASYNC_LAMBDA_PER_THREAD>(this);
+        add_option<CROWDING_ENABLED>(this);
         
         add_option<MUTATION_PER_SITE_P>(this);
         
@@ -80,17 +148,36 @@ public:
         add_option<NK_MODEL_K>(this);
         
         add_option<DELAY_GENERATIONS>(this);
+        add_option<DELAY_STATISTICS_EVERY_UPDATE>(this);
+        add_option<DELAY_ARCHIVE_KEYFRAME>(this);
+        add_option<DELAY_ELITISM_MIN_DISTANCE>(this);
+        add_option<METRICS_SHM>(this);
+        add_option<METRICS_KEEP>(this);
+        add_option<METRICS_RSS_PERIOD>(this);
         add_option<DELAY_RANDOM_INSERT>(this);
+        add_option<LAZY_EVALUATION>(this);
+        
+        add_option<STOP_TARGET_W>(this);
+        add_option<STOP_STAGNATION_WINDOW>(this);
+        add_option<STOP_EVALUATION_BUDGET>(this);
+        add_option<MEMORY_BUDGET>(this);
+        add_option<MEMORY_LOD_DEPTH>(this);
+        add_option<GENOME_INTERNING>(this);
+        add_option<LINEAGE_TRUNCATE_LOD>(this);
+        add_option<PARENT_QUALITY_MUTATION_STEP>(this);
+        add_option<RUN_LOG>(this);
+#ifdef HIMALAYA_HASHED_NK
+        add_option<NEIGHBORHOOD_CLIMB_STEPS>(this);
+#endif
     }
     
     //! Define events (e.g., datafiles) here.
     virtual void gather_events(EA& ea) {
+        add_event<static_events<lazy_flush>::type>(ea);
         add_event<datafiles::fitness_dat>(ea);
         add_event<datafiles::fitness_evaluations>(ea);
         add_event<lod_event>(ea);
-        add_event<effective_fitness>(ea);
-        add_event<dominant_archive>(ea);
-        add_event<random_individuals>(ea);
+        add_event<delay_events::type>(ea);
     };
     
     virtual void gather_tools() {
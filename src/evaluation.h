@@ -0,0 +1,149 @@
+/* evaluation.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EVALUATION_H_
+#define _EVALUATION_H_
+
+#include <memory>
+#include <unordered_set>
+#include <vector>
+#include <ea/metadata.h>
+
+#include "thread_pool.h"
+
+using namespace ealib;
+
+//! Number of worker threads used to evaluate fitness (0 evaluates on the EA's thread).
+LIBEA_MD_DECL(ASYNC_THREADS, "async.threads", int);
+//! If set, newborn individuals (e.g., immigrants) are left unevaluated until something needs their fitness (saves evaluations only with lazy_steady_state).
+LIBEA_MD_DECL(LAZY_EVALUATION, "lazy.evaluation", int);
+
+/* Fitness evaluation split into two halves, so that the expensive half can run
+ on worker threads:
+
+ - evaluate() runs the fitness function, and may be called concurrently for
+ different individuals.  It must only write to the individual being evaluated
+ (the delayed fitness functions in delay.h write DELAY_W_REAL and DELAY_W_EFF,
+ and only read from ancestors).
+
+ - commit_fitness() stores the result and fires fitness_evaluated, which is
+ what datafiles::fitness_evaluations and dominant_archive listen to.  It must
+ be called from the thread that runs the EA.
+
+ Only constant (deterministic) fitness functions are supported, as stochastic
+ ones would all draw from ea.rng().
+ */
+
+//! Overwrite g with a random genome from the EA's ancestor generator.
+template <typename Genome, typename EA>
+void random_genome(Genome& g, EA& ea) {
+    g = typename EA::ancestor_generator_type()(ea);
+}
+
+/*! Overwrite g with a random genome drawn from rng (usually a counter_rng
+ stream; see counter_rng.h).
+
+ Genome types without an overload of their own fall back to the EA's
+ ancestor generator, which draws from ea.rng().
+ */
+template <typename Genome, typename RNG, typename EA>
+void random_genome(Genome& g, RNG& rng, EA& ea) {
+    random_genome(g, ea);
+}
+
+//! Returns true if ind has a fitness.
+template <typename Individual>
+bool is_evaluated(Individual& ind) {
+    return !ind.fitness().is_null();
+}
+
+//! Runs the fitness function on ind, without storing the result.
+template <typename Individual, typename EA>
+double evaluate(Individual& ind, EA& ea) {
+    return static_cast<double>(ea.fitness_function()(ind, ea));
+}
+
+//! Stores w as the fitness of ind, and signals that it was evaluated.
+template <typename Individual, typename EA>
+void commit_fitness(Individual& ind, double w, EA& ea) {
+    ind.fitness() = w;
+    ea.events().fitness_evaluated(ind, ea);
+}
+
+/*! Evaluates the individuals in [f,l) on the given pool.
+
+ Results are committed in iterator order once all evaluations have finished,
+ so the outcome does not depend on the number of threads.
+ */
+template <typename ForwardIterator, typename EA>
+void evaluate_batch(ForwardIterator f, ForwardIterator l, thread_pool& pool, EA& ea) {
+    std::vector<typename EA::individual_ptr_type> inds(f, l);
+    std::vector<double> w(inds.size());
+    pool.parallel_for(inds.size(), [&](std::size_t i) {
+        w[i] = evaluate(*inds[i], ea);
+    });
+    for(std::size_t i=0; i<inds.size(); ++i) {
+        commit_fitness(*inds[i], w[i], ea);
+    }
+}
+
+/*! Returns a pool of ASYNC_THREADS workers, shared by everything that
+ evaluates individuals of this EA type outside of a generational model.
+ */
+template <typename EA>
+thread_pool& evaluation_pool(EA& ea) {
+    static std::shared_ptr<thread_pool> pool(new thread_pool(get<ASYNC_THREADS>(ea,0)));
+    return *pool;
+}
+
+/*! Returns the offspring whose evaluations may still be running on worker
+ threads between updates (see ASYNC_OVERLAP in async_steady_state.h), shared
+ like evaluation_pool().  Their evaluations walk their lines of descent, so
+ anything that edits lines of descent between updates (e.g.,
+ memory::truncate_lod) must treat them as part of the population.
+ */
+template <typename EA>
+typename EA::population_type& inflight_offspring(EA& ea) {
+    static typename EA::population_type inflight;
+    return inflight;
+}
+
+/*! Evaluates those individuals in [f,l) that have not been evaluated yet, in
+ one batch, in iterator order.
+
+ This is how lazily evaluated individuals (see lazy.h) are brought up to date
+ before anything reads their fitness.  Individuals that appear more than once
+ are evaluated once.
+ */
+template <typename ForwardIterator, typename EA>
+void evaluate_pending(ForwardIterator f, ForwardIterator l, EA& ea) {
+    std::vector<typename EA::individual_ptr_type> pending;
+    std::unordered_set<typename EA::individual_type*> seen;
+    for( ; f!=l; ++f) {
+        if(!is_evaluated(**f) && seen.insert(&**f).second) {
+            pending.push_back(*f);
+        }
+    }
+    if(pending.empty()) {
+        return;
+    }
+    evaluate_batch(pending.begin(), pending.end(), evaluation_pool(ea), ea);
+}
+
+#endif
@@ -0,0 +1,314 @@
+/* genome_log.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _GENOME_LOG_H_
+#define _GENOME_LOG_H_
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+#include "counting_allocator.h"
+#include "packed_bitstring.h"
+
+/*! How genome_log stores genomes: keyframes as each value in turn, and deltas
+ as (uint32 locus, value) pairs.
+ */
+template <typename Genome>
+struct genome_log_codec {
+    typedef typename Genome::value_type value_type;
+
+    enum { id=0 }; //!< Codec written to the header (RAW).
+
+    //! Returns the size of a keyframe of g, in bytes.
+    static std::size_t keyframe_bytes(const Genome& g) {
+        return g.size() * sizeof(value_type);
+    }
+
+    //! Returns the size of a delta of n loci, in bytes.
+    static std::size_t delta_bytes(std::size_t n) {
+        return n * (sizeof(boost::uint32_t) + sizeof(value_type));
+    }
+
+    //! Appends the loci at which a and b (of the same size) differ to loci.
+    template <typename Loci>
+    static void changed(const Genome& a, const Genome& b, Loci& loci) {
+        for(std::size_t i=0; i<a.size(); ++i) {
+            if(static_cast<value_type>(a[i]) != static_cast<value_type>(b[i])) {
+                loci.push_back(static_cast<boost::uint32_t>(i));
+            }
+        }
+    }
+
+    static void write_keyframe(std::ostream& out, const Genome& g) {
+        for(std::size_t i=0; i<g.size(); ++i) {
+            value_type v=static_cast<value_type>(g[i]);
+            out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+        }
+    }
+
+    static void read_keyframe(std::istream& in, std::size_t count, Genome& g) {
+        g.resize(count);
+        value_type v;
+        for(std::size_t i=0; i<count; ++i) {
+            in.read(reinterpret_cast<char*>(&v), sizeof(v));
+            g[i] = v;
+        }
+    }
+
+    template <typename Loci>
+    static void write_delta(std::ostream& out, const Genome& g, const Loci& loci) {
+        for(std::size_t i=0; i<loci.size(); ++i) {
+            value_type v=static_cast<value_type>(g[loci[i]]);
+            out.write(reinterpret_cast<const char*>(&loci[i]), sizeof(boost::uint32_t));
+            out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+        }
+    }
+
+    static void read_delta(std::istream& in, std::size_t count, Genome& g) {
+        boost::uint32_t locus;
+        value_type v;
+        for(std::size_t i=0; i<count; ++i) {
+            in.read(reinterpret_cast<char*>(&locus), sizeof(locus));
+            in.read(reinterpret_cast<char*>(&v), sizeof(v));
+            g[locus] = v;
+        }
+    }
+};
+
+/*! Packed bitstrings are stored a word at a time: keyframes as their 64-bit
+ words, and deltas as the uint32 loci of the bits that flipped.
+ */
+template <>
+struct genome_log_codec<packed_bitstring> {
+    typedef packed_bitstring::word_type word_type;
+
+    enum { id=1 }; //!< Codec written to the header (PACKED_BITS).
+
+    static std::size_t keyframe_bytes(const packed_bitstring& g) {
+        return packed_bitstring::nwords(g.size()) * sizeof(word_type);
+    }
+
+    static std::size_t delta_bytes(std::size_t n) {
+        return n * sizeof(boost::uint32_t);
+    }
+
+    template <typename Loci>
+    static void changed(const packed_bitstring& a, const packed_bitstring& b, Loci& loci) {
+        const packed_bitstring::word_vector& x=a.words();
+        const packed_bitstring::word_vector& y=b.words();
+        for(std::size_t i=0; i<x.size(); ++i) {
+            for(word_type d=x[i]^y[i]; d!=0; d&=d-1) {
+                loci.push_back(static_cast<boost::uint32_t>(i * packed_bitstring::word_bits + __builtin_ctzll(d)));
+            }
+        }
+    }
+
+    static void write_keyframe(std::ostream& out, const packed_bitstring& g) {
+        const packed_bitstring::word_vector& w=g.words();
+        if(!w.empty()) {
+            out.write(reinterpret_cast<const char*>(&w[0]), w.size() * sizeof(word_type));
+        }
+    }
+
+    static void read_keyframe(std::istream& in, std::size_t count, packed_bitstring& g) {
+        g.resize(count);
+        packed_bitstring::word_vector& w=g.words();
+        if(!w.empty()) {
+            in.read(reinterpret_cast<char*>(&w[0]), w.size() * sizeof(word_type));
+        }
+    }
+
+    template <typename Loci>
+    static void write_delta(std::ostream& out, const packed_bitstring& g, const Loci& loci) {
+        if(!loci.empty()) {
+            out.write(reinterpret_cast<const char*>(&loci[0]), loci.size() * sizeof(boost::uint32_t));
+        }
+    }
+
+    static void read_delta(std::istream& in, std::size_t count, packed_bitstring& g) {
+        boost::uint32_t locus;
+        for(std::size_t i=0; i<count; ++i) {
+            in.read(reinterpret_cast<char*>(&locus), sizeof(locus));
+            g.flip(locus);
+        }
+    }
+};
+
+/*! Append-only, on-disk log of a sequence of genomes.
+
+ Successive genomes in the log are usually close relatives (e.g., each
+ dominant of a run), so most entries are stored as the list of loci that
+ differ from the previous entry.  Every keyframe_period'th entry, and any
+ entry whose delta would be larger than the genome itself, is stored in full.
+ Only a small per-entry index, and the most recent genome, are kept in memory.
+
+ The file format is:
+
+ header: char[4] "HGL2", uint32 codec (0=raw, 1=packed bits), uint32
+ sizeof(Genome::value_type)
+ entries: uint32 kind (0=keyframe, 1=delta), uint32 count, uint64 update,
+ double w, followed by the genome (keyframe) or the changes to the previous
+ entry (delta).
+
+ Raw genomes are count values, and deltas count (uint32 locus, value) pairs.
+ Packed bitstrings (see genome_log_codec<packed_bitstring>) are count bits
+ in ceil(count/64) uint64 words, and deltas count uint32 loci whose bits
+ flipped.  All fields are in host byte order.
+ */
+template <typename Genome>
+class genome_log {
+public:
+    typedef Genome genome_type;
+    typedef typename Genome::value_type value_type;
+    typedef genome_log_codec<Genome> codec_type;
+
+    enum { KEYFRAME=0, DELTA=1 };
+
+    //! Per-entry index.
+    struct entry {
+        boost::uint64_t update; //!< Update at which the entry was appended.
+        double w; //!< Fitness of the logged genome.
+        std::streamoff offset; //!< File offset of this entry.
+        std::size_t keyframe; //!< Index of the keyframe that this entry is relative to.
+    };
+
+    //! Constructor; creates (truncates) the log file.
+    genome_log(const std::string& filename, std::size_t keyframe_period=64)
+    : _period(keyframe_period ? keyframe_period : 1) {
+        _f.open(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!_f.is_open()) {
+            throw std::runtime_error("genome_log: could not open " + filename);
+        }
+        _f.write("HGL2", 4);
+        write_pod(static_cast<boost::uint32_t>(codec_type::id));
+        write_pod(static_cast<boost::uint32_t>(sizeof(value_type)));
+        _f.flush();
+        check("write");
+    }
+
+    //! Returns the number of entries.
+    std::size_t size() const { return _index.size(); }
+
+    //! Returns true if the log is empty.
+    bool empty() const { return _index.empty(); }
+
+    //! Returns the index entry for entry i.
+    const entry& operator[](std::size_t i) const { return _index[i]; }
+
+    //! Returns the index entry for the most recent entry.
+    const entry& back() const { return _index.back(); }
+
+    //! Appends g to the log, and flushes it to disk.
+    void append(const Genome& g, boost::uint64_t update, double w) {
+        entry e;
+        e.update = update;
+        e.w = w;
+        e.offset = _f.seekp(0, std::ios::end).tellp();
+
+        // find the loci that changed since the last entry:
+        _loci.clear();
+        bool keyframe=_index.empty()
+        || ((_index.size() % _period) == 0)
+        || (_last.size() != g.size());
+        if(!keyframe) {
+            codec_type::changed(g, _last, _loci);
+            keyframe = (codec_type::delta_bytes(_loci.size()) >= codec_type::keyframe_bytes(g));
+        }
+
+        if(keyframe) {
+            e.keyframe = _index.size();
+            write_header(KEYFRAME, g.size(), update, w);
+            codec_type::write_keyframe(_f, g);
+        } else {
+            e.keyframe = _index.back().keyframe;
+            write_header(DELTA, _loci.size(), update, w);
+            codec_type::write_delta(_f, g, _loci);
+        }
+        _f.flush();
+        check("write");
+        _index.push_back(e);
+        _last = g;
+    }
+
+    //! Releases the slack in the index, and the scratch space for changed loci.
+    void compact() {
+        _index.shrink_to_fit();
+        _loci.clear();
+        _loci.shrink_to_fit();
+    }
+
+    //! Reconstructs the genome of entry i by replaying from its keyframe.
+    Genome genome(std::size_t i) {
+        Genome g;
+        for(std::size_t j=_index.at(i).keyframe; j<=i; ++j) {
+            _f.seekg(_index[j].offset);
+            boost::uint32_t kind=read_pod<boost::uint32_t>();
+            boost::uint32_t count=read_pod<boost::uint32_t>();
+            read_pod<boost::uint64_t>();
+            read_pod<double>();
+            if(kind == KEYFRAME) {
+                codec_type::read_keyframe(_f, count, g);
+            } else {
+                codec_type::read_delta(_f, count, g);
+            }
+        }
+        check("read");
+        _f.seekp(0, std::ios::end);
+        return g;
+    }
+
+protected:
+    //! Throws if the last operation on the file failed.
+    void check(const char* op) {
+        if(!_f) {
+            _f.clear();
+            throw std::runtime_error(std::string("genome_log: ") + op + " failed");
+        }
+    }
+
+    template <typename T>
+    void write_pod(const T& t) {
+        _f.write(reinterpret_cast<const char*>(&t), sizeof(T));
+    }
+
+    template <typename T>
+    T read_pod() {
+        T t;
+        _f.read(reinterpret_cast<char*>(&t), sizeof(T));
+        return t;
+    }
+
+    void write_header(boost::uint32_t kind, std::size_t count, boost::uint64_t update, double w) {
+        write_pod(kind);
+        write_pod(static_cast<boost::uint32_t>(count));
+        write_pod(update);
+        write_pod(w);
+    }
+
+    std::size_t _period; //!< Entries between keyframes.
+    std::fstream _f; //!< Log file.
+    std::vector<entry, memory::counting_allocator<entry, memory::ARCHIVE> > _index; //!< In-memory index of entries.
+    std::vector<boost::uint32_t, memory::counting_allocator<boost::uint32_t, memory::ARCHIVE> > _loci; //!< Scratch space for changed loci.
+    Genome _last; //!< Most recently appended genome.
+};
+
+#endif
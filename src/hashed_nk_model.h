@@ -0,0 +1,219 @@
+/* hashed_nk_model.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _HASHED_NK_MODEL_H_
+#define _HASHED_NK_MODEL_H_
+
+#include <algorithm>
+#include <stdexcept>
+#include <boost/cstdint.hpp>
+
+#include <ea/metadata.h>
+#include <ea/fitness_function.h>
+#include <ea/fitness_functions/nk_model.h>
+
+#include "packed_bitstring.h"
+#include "statistics.h"
+
+using namespace ealib;
+
+/*! NK landscape whose contributions are computed on demand, instead of being
+ stored in an N x 2^(K+1) table.
+
+ The contribution of locus i is a hash of (FF_RNG_SEED, i, the K+1 bits
+ i..i+K, wrapping around the end of the genome), scaled to [0,1).  Fitness is
+ the mean contribution over all loci.  The landscape is therefore fully
+ determined by FF_RNG_SEED, takes no memory, and supports any K < 64 (and
+ K < N).  It is a different landscape than nk_model's for the same seed.
+
+ Loci are processed in blocks: first their neighborhoods are gathered (a
+ couple of shifts per locus for packed_bitstrings), then the block is hashed
+ in a branch-free loop that the compiler can vectorize.  Evaluation does not
+ modify the model, so it is safe to call from several threads at once.
+ */
+struct hashed_nk_model : fitness_function<unary_fitness<double>, constantS, deterministicS> {
+    typedef boost::uint64_t key_type;
+    enum { BLOCK=64 }; //!< Loci per block.
+
+    //! Constructor.
+    hashed_nk_model() : _n(0), _k(0), _seed(0) {
+    }
+
+    //! Initialize this fitness function.
+    template <typename EA>
+    void initialize(EA& ea) {
+        _n = get<NK_MODEL_N>(ea);
+        _k = get<NK_MODEL_K>(ea);
+        _seed = static_cast<key_type>(get<FF_RNG_SEED>(ea));
+        if((_k >= 64) || (_k >= _n)) {
+            throw std::invalid_argument("hashed_nk_model: K must be less than both 64 and N");
+        }
+    }
+
+    //! Returns N.
+    std::size_t n() const { return _n; }
+
+    //! Returns K.
+    std::size_t k() const { return _k; }
+
+    //! Returns the contribution of the given locus with neighborhood bits.
+    double contribution(std::size_t locus, key_type bits) const {
+        key_type h=mix(bits ^ mix(_seed + GOLDEN * (static_cast<key_type>(locus) + 1)));
+        return static_cast<double>(h >> 11) * (1.0 / 9007199254740992.0); // 2^-53
+    }
+
+    //! Returns the K+1 bits of the neighborhood of locus i, with bit i least significant.
+    template <typename Genome>
+    key_type neighborhood(const Genome& g, std::size_t i) const {
+        key_type x=0;
+        for(std::size_t j=0; j<=_k; ++j) {
+            x |= static_cast<key_type>(g[(i+j) % _n] & 0x01) << j;
+        }
+        return x;
+    }
+
+    //! Returns the K+1 bits of the neighborhood of locus i (packed_bitstring).
+    key_type neighborhood(const packed_bitstring& g, std::size_t i) const {
+        std::size_t w=_k+1;
+        if((i+w) <= _n) {
+            return g.bits(i, w);
+        }
+        std::size_t lo=_n-i;
+        return g.bits(i, lo) | (g.bits(0, w-lo) << lo);
+    }
+
+    //! Returns the fitness of genome g.
+    template <typename Genome>
+    double fitness(const Genome& g) const {
+        key_type x[BLOCK];
+        double c[BLOCK];
+        double s=0.0;
+        for(std::size_t i=0; i<_n; i+=BLOCK) {
+            std::size_t m=std::min(static_cast<std::size_t>(BLOCK), _n-i);
+            for(std::size_t j=0; j<m; ++j) {
+                x[j] = neighborhood(g, i+j);
+            }
+            for(std::size_t j=0; j<m; ++j) {
+                c[j] = contribution(i+j, x[j]);
+            }
+            s += statistics::sum(c, m);
+        }
+        return s / static_cast<double>(_n);
+    }
+
+    //! Calculate the fitness of an individual.
+    template <typename Individual, typename EA>
+    double operator()(Individual& ind, EA& ea) {
+        return fitness(ind.genome());
+    }
+
+protected:
+    static const key_type GOLDEN=0x9e3779b97f4a7c15ULL; //!< 2^64 / golden ratio.
+
+    //! 64-bit finalizer from SplitMix64.
+    static key_type mix(key_type z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    std::size_t _n; //!< Number of loci.
+    std::size_t _k; //!< Number of epistatic neighbors per locus.
+    key_type _seed; //!< Landscape seed.
+};
+
+/*! hashed_nk_model with N and K fixed at compile time.
+
+ The same landscape, but its fitness loops have constant bounds, so they can
+ be fully unrolled, and the neighborhoods of a packed_bitstring of up to 64
+ bits are rotations of its single word (longer ones are left to
+ hashed_nk_model, which already gathers them a word at a time).  Contributions are summed in the same
+ order as hashed_nk_model, so fitnesses are identical.  If NK_MODEL_N and
+ NK_MODEL_K (or the genome size) do not match N and K at runtime, it falls
+ back to hashed_nk_model.  It is a different landscape from libea's table
+ nk_model, which is not specialized.
+ */
+template <std::size_t N, std::size_t K>
+struct fixed_nk_model : hashed_nk_model {
+    static_assert((K < 64) && (K < N), "fixed_nk_model: K must be less than both 64 and N");
+
+    //! Returns true if g is evaluated with the fixed N and K.
+    template <typename Genome>
+    bool fixed(const Genome& g) const {
+        return (_n == N) && (_k == K) && (g.size() == N);
+    }
+
+    //! Returns the fitness of genome g.
+    template <typename Genome>
+    double fitness(const Genome& g) const {
+        if(!fixed(g)) {
+            return hashed_nk_model::fitness(g);
+        }
+        key_type x[N];
+        for(std::size_t i=0; i<N; ++i) {
+            x[i] = 0;
+            for(std::size_t j=0; j<=K; ++j) {
+                x[i] |= static_cast<key_type>(g[(i+j) % N] & 0x01) << j;
+            }
+        }
+        return mean_contribution(x);
+    }
+
+    //! Returns the fitness of genome g (packed_bitstring).
+    double fitness(const packed_bitstring& g) const {
+        if((N > 64) || !fixed(g)) {
+            return hashed_nk_model::fitness(g);
+        }
+        const key_type mask=(K == 63) ? ~key_type(0) : ((key_type(1) << (K+1)) - 1);
+        const key_type w=g.bits(0, N);
+        key_type x[N];
+        x[0] = w & mask;
+        for(std::size_t i=1; i<N; ++i) {
+            x[i] = ((w >> i) | (w << ((N - i) % 64))) & mask;
+        }
+        return mean_contribution(x);
+    }
+
+    //! Calculate the fitness of an individual.
+    template <typename Individual, typename EA>
+    double operator()(Individual& ind, EA& ea) {
+        return fitness(ind.genome());
+    }
+
+protected:
+    //! Returns the mean contribution of the N neighborhoods x.
+    double mean_contribution(const key_type* x) const {
+        double s=0.0;
+        for(std::size_t i=0; i<N; i+=BLOCK) {
+            // add them up in the same order as statistics::sum does for hashed_nk_model:
+            const std::size_t m=std::min(static_cast<std::size_t>(BLOCK), N-i), q=m - m%4;
+            double a[4]={0.0, 0.0, 0.0, 0.0};
+            for(std::size_t j=0; j<q; ++j) {
+                a[j%4] += contribution(i+j, x[i+j]);
+            }
+            for(std::size_t j=q; j<m; ++j) {
+                a[0] += contribution(i+j, x[i+j]);
+            }
+            s += (a[0] + a[1]) + (a[2] + a[3]);
+        }
+        return s / static_cast<double>(N);
+    }
+};
+
+#endif
@@ -0,0 +1,164 @@
+/* interning.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _INTERNING_H_
+#define _INTERNING_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <ea/metadata.h>
+
+using namespace ealib;
+
+//! If set (the default), genomes that support it are interned once evaluated.
+LIBEA_MD_DECL(GENOME_INTERNING, "genome.interning", int);
+
+/*! Pool of interned (hash-consed) values.
+
+ intern(x) returns a shared, immutable copy of x: the same one for all equal
+ values that are alive at the same time.  Values are released when their last
+ reference goes away.  The table is split into shards by hash, each with its
+ own mutex, so that values can be interned and released from any thread.
+
+ There is one pool per value type (see instance()); it is never destroyed, so
+ that values outliving static destruction can still be released.
+ */
+template <typename T, typename Hash=std::hash<T>, typename Equal=std::equal_to<T> >
+class intern_pool {
+public:
+    typedef std::shared_ptr<const T> pointer;
+    enum { SHARDS=16 };
+
+    //! Returns the pool for this value type.
+    static intern_pool& instance() {
+        static intern_pool* pool=new intern_pool();
+        return *pool;
+    }
+
+    //! Returns the interned value equal to x, interning a copy of x if there is none.
+    pointer intern(const T& x) {
+        key k(&x, _hash(x));
+        shard& s=_shards[k.h % SHARDS];
+        std::lock_guard<std::mutex> lock(s.mutex);
+        typename table_type::iterator i=s.table.find(k);
+        if(i != s.table.end()) {
+            pointer p=i->second.lock();
+            if(p) {
+                return p;
+            }
+            s.table.erase(i); // its last reference is being released
+        }
+        pointer p(new T(x), releaser(this, k.h));
+        s.table.insert(std::make_pair(key(p.get(), k.h), std::weak_ptr<const T>(p)));
+        return p;
+    }
+
+    //! Returns the number of interned values.
+    std::size_t size() {
+        std::size_t n=0;
+        for(std::size_t i=0; i<SHARDS; ++i) {
+            std::lock_guard<std::mutex> lock(_shards[i].mutex);
+            n += _shards[i].table.size();
+        }
+        return n;
+    }
+
+protected:
+    //! Table key: a value, and its hash.
+    struct key {
+        key(const T* p_, std::size_t h_) : p(p_), h(h_) { }
+        const T* p;
+        std::size_t h;
+    };
+
+    struct key_hash {
+        std::size_t operator()(const key& k) const { return k.h; }
+    };
+
+    struct key_equal {
+        bool operator()(const key& x, const key& y) const { return (x.h == y.h) && Equal()(*x.p, *y.p); }
+    };
+
+    typedef std::unordered_map<key, std::weak_ptr<const T>, key_hash, key_equal> table_type;
+
+    struct shard {
+        std::mutex mutex;
+        table_type table;
+    };
+
+    //! Deleter of interned values; removes them from the table.
+    struct releaser {
+        releaser(intern_pool* pool, std::size_t h) : _pool(pool), _h(h) { }
+        void operator()(const T* p) const {
+            _pool->release(p, _h);
+            delete p;
+        }
+        intern_pool* _pool;
+        std::size_t _h;
+    };
+
+    //! Removes p from the table, unless it has already been replaced.
+    void release(const T* p, std::size_t h) {
+        shard& s=_shards[h % SHARDS];
+        std::lock_guard<std::mutex> lock(s.mutex);
+        typename table_type::iterator i=s.table.find(key(p, h));
+        if((i != s.table.end()) && (i->first.p == p)) {
+            s.table.erase(i);
+        }
+    }
+
+    intern_pool() {
+    }
+
+    Hash _hash; //!< Value hash.
+    shard _shards[SHARDS]; //!< Table, by hash.
+};
+
+//! Interns g, for genome types that support it; others are left alone.
+template <typename Genome>
+void intern_genome(Genome& g) {
+}
+
+/*! Interns each genome once it has been evaluated (see packed_bitstring),
+ unless GENOME_INTERNING is 0.
+
+ Identical genomes in the population, the line of descent and the archives
+ then share one copy, which is copied again only when it is modified.  Add
+ it to the EA through static_events (see static_events.h), before anything
+ that copies genomes.
+ */
+template <typename EA>
+struct genome_interning {
+    genome_interning(EA& ea) : _on(get<GENOME_INTERNING>(ea, 1) != 0) {
+    }
+
+    void fitness_evaluated(typename EA::individual_type& ind, EA& ea) {
+        if(_on) {
+            intern_genome(ind.genome());
+        }
+    }
+
+    bool _on; //!< True if interning is enabled.
+};
+
+#endif
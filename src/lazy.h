@@ -0,0 +1,168 @@
+/* lazy.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _LAZY_H_
+#define _LAZY_H_
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include <ea/metadata.h>
+#include <ea/selection/tournament.h>
+#include <ea/generational_models/steady_state.h>
+
+#include "evaluation.h"
+
+using namespace ealib;
+
+/* Lazy fitness evaluation.
+
+ An individual whose fitness is null (see is_evaluated()) is "pending": it has
+ been born, but nothing has needed its fitness yet.  Pending individuals are
+ evaluated, in batches, by whatever first reads their fitness (evaluate_pending
+ in evaluation.h); those that are replaced before that are never evaluated at
+ all.  Since only evaluations that actually happen fire fitness_evaluated,
+ datafiles::fitness_evaluations counts exactly the evaluations that were run.
+ */
+
+/*! Orders individuals by fitness, with pending individuals before (i.e., less
+ fit than) all evaluated ones.  Never evaluates anything.
+ */
+struct pending_first {
+    template <typename IndividualPtr>
+    bool operator()(const IndividualPtr& x, const IndividualPtr& y) const {
+        if(!is_evaluated(*x) || !is_evaluated(*y)) {
+            return !is_evaluated(*x) && is_evaluated(*y);
+        }
+        return static_cast<double>(x->fitness()) < static_cast<double>(y->fitness());
+    }
+};
+
+/*! Tournament selection that evaluates pending individuals in one batch.
+
+ Selecting n individuals runs ceil(n/TOURNAMENT_SELECTION_K) tournaments of
+ TOURNAMENT_SELECTION_N distinct individuals each; the K fittest of each
+ tournament are selected.  All tournaments are drawn before any is decided, so
+ that the pending individuals among them can be evaluated together.
+ */
+struct lazy_tournament {
+    //! Initializing constructor.
+    template <typename Population, typename EA>
+    lazy_tournament(std::size_t n, Population& src, EA& ea) {
+    }
+
+    //! Select n individuals from src into dst.
+    template <typename Population, typename EA>
+    void operator()(Population& src, Population& dst, std::size_t n, EA& ea) {
+        std::size_t N=std::min(static_cast<std::size_t>(get<TOURNAMENT_SELECTION_N>(ea)), src.size());
+        std::size_t K=std::min(static_cast<std::size_t>(get<TOURNAMENT_SELECTION_K>(ea)), N);
+        assert(K > 0);
+        std::size_t t=(n + K - 1) / K;
+
+        // draw every tournament:
+        Population drawn;
+        drawn.reserve(t * N);
+        std::vector<std::size_t> idx;
+        for(std::size_t i=0; i<t; ++i) {
+            idx.clear();
+            while(idx.size() < N) {
+                std::size_t j=ea.rng().uniform_integer(0, static_cast<int>(src.size()));
+                if(std::find(idx.begin(), idx.end(), j) == idx.end()) {
+                    idx.push_back(j);
+                    drawn.push_back(src[j]);
+                }
+            }
+        }
+
+        evaluate_pending(drawn.begin(), drawn.end(), ea);
+
+        // and then decide them:
+        for(std::size_t i=0; (i<t) && (n>0); ++i) {
+            typename Population::iterator f=drawn.begin() + i*N;
+            std::sort(f, f+N, pending_first());
+            for(std::size_t k=0; (k<K) && (n>0); ++k, --n) {
+                dst.push_back(*(f + N - 1 - k));
+            }
+        }
+    }
+};
+
+/*! Steady-state generational model that does not evaluate offspring.
+
+ Each update, STEADY_STATE_LAMBDA offspring are bred and replace as many
+ victims, chosen at random from all but the ELITISM_N fittest evaluated
+ individuals.  Offspring stay pending until parent selection (e.g.,
+ lazy_tournament), survivor selection (e.g., delayed_elitism), or statistics
+ (e.g., lazy_flush) need their fitness.
+
+ Any parent selection strategy can be used; ealib's own selection strategies
+ evaluate pending individuals one at a time through fitness(ind, ea).
+ */
+template <typename ParentSelectionStrategy>
+struct lazy_steady_state {
+    typedef ParentSelectionStrategy parent_selection_type;
+
+    //! Apply this generational model to the population.
+    template <typename Population, typename EA>
+    void operator()(Population& population, EA& ea) {
+        std::size_t e=std::min(static_cast<std::size_t>(get<ELITISM_N>(ea,0)), population.size());
+        std::size_t n=std::min(static_cast<std::size_t>(get<STEADY_STATE_LAMBDA>(ea)), population.size()-e);
+        if(n == 0) {
+            return;
+        }
+
+        Population offspring;
+        recombine_n(population, offspring,
+                    parent_selection_type(n, population, ea),
+                    typename EA::recombination_operator_type(),
+                    n, ea);
+        mutate(offspring.begin(), offspring.end(), ea);
+
+        // move the elite to the back, out of the way:
+        if(e > 0) {
+            std::nth_element(population.begin(), population.end()-e, population.end(), pending_first());
+        }
+
+        // choose n distinct victims from the front, and replace them:
+        std::size_t m=population.size() - e;
+        for(std::size_t i=0; i<n; ++i) {
+            std::swap(population[i], population[i + ea.rng().uniform_integer(0, static_cast<int>(m-i))]);
+            population[i] = offspring[i];
+        }
+    }
+};
+
+/*! Evaluates all pending individuals before statistics are recorded, so that
+ datafiles never see an unevaluated individual.
+
+ Must be added (see static_events.h) before any record_statistics event that
+ reads fitness.
+ */
+template <typename EA>
+struct lazy_flush {
+    lazy_flush(EA& ea) {
+    }
+
+    void record_statistics(EA& ea) {
+        evaluate_pending(ea.population().begin(), ea.population().end(), ea);
+    }
+};
+
+#endif
@@ -0,0 +1,282 @@
+/* lineage_lag.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _LINEAGE_LAG_H_
+#define _LINEAGE_LAG_H_
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <ea/metadata.h>
+#include <ea/datafile.h>
+
+#include "delay.h"
+#include "memory.h"
+#include "statistics.h"
+
+using namespace ealib;
+
+//! Sum of w_real - w_eff over an individual's lineage (itself included, once evaluated).
+LIBEA_MD_DECL(LINEAGE_LAG_SUM, "lineage.lag_sum", double);
+//! Number of evaluated individuals in that sum.
+LIBEA_MD_DECL(LINEAGE_LAG_N, "lineage.lag_n", double);
+//! Name of the most recent record-setting ancestor (itself included), or -1.
+LIBEA_MD_DECL(LINEAGE_MARKER, "lineage.marker", double);
+//! If set, the line of descent is cut to DELAY_GENERATIONS+1 ancestors every update.
+LIBEA_MD_DECL(LINEAGE_TRUNCATE_LOD, "lineage.truncate_lod", int);
+
+/* Lineage lag analytics.
+
+ How far effective fitness (DELAY_W_EFF) lags real fitness (DELAY_W_REAL),
+ measured online instead of by dumping and post-processing the line of
+ descent.  Only the two fitness values are read, so this works with
+ generation_delay, mean_delay and peak_delay alike.
+
+ - Lag: at evaluation, each individual adds its lag (w_real - w_eff) to the
+ running sum it inherited at birth from its first parent, so the mean lag
+ along its whole lineage is known without walking it.
+
+ - Fixation: an individual whose real fitness beats the best ever seen becomes
+ a "marker", and its descendants inherit the marker at birth.  Markers form a
+ tree (each knows the marker its founder carried).  A marker has fixed when
+ every individual that carries any marker carries it or one of its
+ descendants; founders, immigrants, and lineages that have never set a record
+ do not count, since a steady stream of immigrants would otherwise prevent
+ any fixation.  The fixation latency is the number of updates from the
+ marker's birth.  Markers are forgotten once nobody carries them (or their
+ descendants), so only markers that are segregating or fixed and still
+ carried are kept.
+
+ - Rank discordance: the fraction of pairs of evaluated individuals that
+ effective and real fitness order differently (Kendall's tau distance),
+ counted as inversions in O(P log P).
+ */
+
+namespace lineage {
+
+//! A record-setting ancestor.
+struct marker {
+    marker(long p=-1, unsigned long b=0) : parent(p), born(b), count(0), fixed(false) { }
+    long parent; //!< Marker carried by this marker's founder, or -1.
+    unsigned long born; //!< Update at which it was set.
+    std::size_t count; //!< Scratch: carriers of this marker or its descendants.
+    bool fixed; //!< True once it has fixed.
+};
+
+/*! Returns the number of pairs (i<j) in [f, l) with *i > *j, and sorts the
+ range; tmp is scratch space.
+ */
+template <typename RandomAccessIterator>
+std::size_t count_inversions(RandomAccessIterator f, RandomAccessIterator l, std::vector<double>& tmp) {
+    std::size_t n=l - f;
+    if(n < 2) {
+        return 0;
+    }
+    RandomAccessIterator m=f + n/2;
+    std::size_t c=count_inversions(f, m, tmp) + count_inversions(m, l, tmp);
+    tmp.clear();
+    RandomAccessIterator i=f, j=m;
+    while((i != m) && (j != l)) {
+        if(*j < *i) {
+            c += m - i;
+            tmp.push_back(*j++);
+        } else {
+            tmp.push_back(*i++);
+        }
+    }
+    tmp.insert(tmp.end(), i, m);
+    tmp.insert(tmp.end(), j, l);
+    std::copy(tmp.begin(), tmp.end(), f);
+    return c;
+}
+
+} // lineage
+
+/*! Writes lag.dat every RECORDING_PERIOD updates: the mean and max lag over
+ the population, the mean lineage lag, the rank discordance, the number of
+ segregating markers, and the number and mean latency of fixations since the
+ last row (see above).  Only evaluated individuals are counted; nothing is
+ evaluated.
+
+ The delay fitness functions still read DELAY_GENERATIONS ancestors through
+ lod_trait, so lod_event stays; but nothing here needs older ancestors, and if
+ LINEAGE_TRUNCATE_LOD is set the line of descent is cut every update (see
+ memory::truncate_lod), so that it is never retained in full.  The cut is one
+ generation deeper than the delay, as walking DELAY_GENERATIONS ancestors
+ reads the parents of the last of them, and may still be under way on a
+ worker thread (ASYNC_OVERLAP).
+ Add it to the EA through static_events (see static_events.h).
+ */
+template <typename EA>
+struct lineage_lag {
+    typedef typename EA::fitness_function_type::direction_tag direction_tag;
+
+    lineage_lag(EA& ea) : _has_record(false), _record(0.0), _fixations(0), _latency(0.0), _df("lag.dat") {
+        _df.add_field("update")
+        .add_field("mean_lag")
+        .add_field("max_lag")
+        .add_field("mean_lineage_lag")
+        .add_field("rank_discordance")
+        .add_field("segregating")
+        .add_field("fixations")
+        .add_field("mean_fixation_latency");
+    }
+
+    void inheritance(typename EA::population_type& parents, typename EA::individual_type& offspring, EA& ea) {
+        typename EA::individual_type& p=*parents.front();
+        put<LINEAGE_LAG_SUM>(get<LINEAGE_LAG_SUM>(p, 0.0), offspring);
+        put<LINEAGE_LAG_N>(get<LINEAGE_LAG_N>(p, 0.0), offspring);
+        put<LINEAGE_MARKER>(get<LINEAGE_MARKER>(p, -1.0), offspring);
+    }
+
+    void fitness_evaluated(typename EA::individual_type& ind, EA& ea) {
+        if(!exists<DELAY_W_REAL>(ind) || !exists<DELAY_W_EFF>(ind)) {
+            return;
+        }
+        if(founder(ind)) {
+            // founders and immigrants (whose storage may be reused) start a lineage:
+            put<LINEAGE_LAG_SUM>(0.0, ind);
+            put<LINEAGE_LAG_N>(0.0, ind);
+            put<LINEAGE_MARKER>(-1.0, ind);
+        }
+        double w=get<DELAY_W_REAL>(ind);
+        put<LINEAGE_LAG_SUM>(get<LINEAGE_LAG_SUM>(ind, 0.0) + (w - get<DELAY_W_EFF>(ind)), ind);
+        put<LINEAGE_LAG_N>(get<LINEAGE_LAG_N>(ind, 0.0) + 1.0, ind);
+
+        if(!_has_record || better(w, _record, direction_tag())) {
+            _has_record = true;
+            _record = w;
+            long name=static_cast<long>(ind.name());
+            _markers[name] = lineage::marker(static_cast<long>(get<LINEAGE_MARKER>(ind, -1.0)), ea.current_update());
+            put<LINEAGE_MARKER>(static_cast<double>(name), ind);
+        }
+    }
+
+    void end_of_update(EA& ea) {
+        if(get<LINEAGE_TRUNCATE_LOD>(ea, 0)) {
+            memory::truncate_lod(ea, get<DELAY_GENERATIONS>(ea) + 1);
+        }
+        if(_markers.empty()) {
+            return;
+        }
+
+        // count carriers, and add them to every ancestral marker (parents are older, so have smaller names):
+        std::size_t tracked=0;
+        for(std::map<long, lineage::marker>::iterator i=_markers.begin(); i!=_markers.end(); ++i) {
+            i->second.count = 0;
+        }
+        for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
+            if(founder(*i)) {
+                continue;
+            }
+            std::map<long, lineage::marker>::iterator m=_markers.find(static_cast<long>(get<LINEAGE_MARKER>(*i, -1.0)));
+            if(m != _markers.end()) {
+                ++m->second.count;
+                ++tracked;
+            }
+        }
+        for(std::map<long, lineage::marker>::reverse_iterator i=_markers.rbegin(); i!=_markers.rend(); ++i) {
+            std::map<long, lineage::marker>::iterator p=_markers.find(i->second.parent);
+            if(p != _markers.end()) {
+                p->second.count += i->second.count;
+            }
+        }
+
+        // note markers that have fixed, and forget those that died out:
+        for(std::map<long, lineage::marker>::iterator i=_markers.begin(); i!=_markers.end(); ) {
+            if(i->second.count == 0) {
+                _markers.erase(i++);
+                continue;
+            }
+            if(!i->second.fixed && (i->second.count == tracked)) {
+                i->second.fixed = true;
+                ++_fixations;
+                _latency += static_cast<double>(ea.current_update() - i->second.born);
+            }
+            ++i;
+        }
+    }
+
+    void record_statistics(EA& ea) {
+        _pairs.clear();
+        _lag.clear();
+        _lineage.clear();
+        for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
+            if(!is_evaluated(*i) || !exists<DELAY_W_REAL>(*i) || !exists<DELAY_W_EFF>(*i)) {
+                continue;
+            }
+            double w_real=get<DELAY_W_REAL>(*i), w_eff=get<DELAY_W_EFF>(*i);
+            _lag.push_back(w_real - w_eff);
+            _lineage.push_back(get<LINEAGE_LAG_SUM>(*i, 0.0) / std::max(get<LINEAGE_LAG_N>(*i, 0.0), 1.0));
+            _pairs.push_back(std::make_pair(w_eff, w_real));
+        }
+
+        // discordant pairs are inversions of w_real when ordered by w_eff (ties by w_real):
+        std::sort(_pairs.begin(), _pairs.end());
+        _w.clear();
+        for(std::size_t i=0; i<_pairs.size(); ++i) {
+            _w.push_back(_pairs[i].second);
+        }
+        double n=static_cast<double>(_w.size());
+        double discordant=static_cast<double>(lineage::count_inversions(_w.begin(), _w.end(), _tmp));
+
+        _df.write(ea.current_update())
+        .write(_lag.mean())
+        .write(_lag.max())
+        .write(_lineage.mean())
+        .write((n > 1) ? (discordant / (n * (n - 1.0) / 2.0)) : 0.0)
+        .write(segregating())
+        .write(_fixations)
+        .write(_fixations ? (_latency / _fixations) : 0.0)
+        .endl();
+        _fixations = 0;
+        _latency = 0.0;
+    }
+
+    //! Returns the number of markers that have not fixed.
+    std::size_t segregating() const {
+        std::size_t n=0;
+        for(std::map<long, lineage::marker>::const_iterator i=_markers.begin(); i!=_markers.end(); ++i) {
+            n += !i->second.fixed;
+        }
+        return n;
+    }
+
+    //! Returns true if ind is a founder or an immigrant.
+    static bool founder(typename EA::individual_type& ind) {
+        return get<IND_GENERATION>(ind, 0.0) <= 0.0;
+    }
+
+    bool _has_record; //!< True once a record has been set.
+    double _record; //!< Best real fitness seen.
+    std::map<long, lineage::marker> _markers; //!< Markers still carried, by name.
+    std::size_t _fixations; //!< Fixations since the last row.
+    double _latency; //!< Sum of their latencies.
+    std::vector<std::pair<double,double> > _pairs; //!< Scratch: (w_eff, w_real) of the population.
+    std::vector<double> _w; //!< Scratch: w_real ordered by w_eff.
+    statistics::sample _lag; //!< Scratch: lag of each evaluated individual.
+    statistics::sample _lineage; //!< Scratch: mean lineage lag of each evaluated individual.
+    std::vector<double> _tmp; //!< Scratch for counting inversions.
+    datafile _df;
+};
+
+#endif
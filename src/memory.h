@@ -0,0 +1,210 @@
+/* memory.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MEMORY_H_
+#define _MEMORY_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <unordered_set>
+#include <vector>
+
+#include <ea/metadata.h>
+#include <ea/datafile.h>
+
+#include "counting_allocator.h"
+#include "delay.h"
+#include "evaluation.h"
+#include "metrics.h"
+
+using namespace ealib;
+
+//! Resident set size (MB) above which memory_accounting starts pruning; 0 disables pruning.
+LIBEA_MD_DECL(MEMORY_BUDGET, "memory.budget", double);
+//! Ancestors kept behind each individual when the line of descent is truncated (raised to DELAY_GENERATIONS+1 if less).
+LIBEA_MD_DECL(MEMORY_LOD_DEPTH, "memory.lod_depth", int);
+
+/* Memory accounting.
+
+ Containers owned by this project allocate through counting_allocator, which
+ keeps a process-wide count of live bytes per component.  Structures owned by
+ libea (individuals, the lod_trait ancestor graph, metadata maps) are measured
+ by walking them, and whatever is left of the resident set size is reported
+ as "other".
+ */
+
+namespace memory {
+
+//! Heap bytes held by a genome; genome types with other storage overload this.
+template <typename Genome>
+double genome_bytes(const Genome& g) {
+    return static_cast<double>(g.capacity() * sizeof(typename Genome::value_type));
+}
+
+/*! Bytes held by the individuals of the population, and by their ancestors,
+ which are kept alive through lod_trait's parent pointers.
+ */
+template <typename EA>
+struct footprint {
+    footprint(EA& ea) : population(0.0), lod(0.0), ancestors(0) {
+        typedef typename EA::individual_type individual_type;
+        std::unordered_set<individual_type*> seen;
+        std::vector<individual_type*> open;
+        for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
+            seen.insert(&*i);
+            open.push_back(&*i);
+            population += sizeof(individual_type) + genome_bytes(i->genome());
+        }
+        while(!open.empty()) {
+            individual_type* p=open.back();
+            open.pop_back();
+            for(typename EA::population_type::iterator j=p->traits().lod_parents().begin(); j!=p->traits().lod_parents().end(); ++j) {
+                if(seen.insert(&**j).second) {
+                    open.push_back(&**j);
+                    ++ancestors;
+                    lod += sizeof(individual_type) + genome_bytes((*j)->genome());
+                }
+            }
+        }
+    }
+
+    double population; //!< Bytes held by the population.
+    double lod; //!< Bytes held by ancestors.
+    std::size_t ancestors; //!< Number of ancestors.
+};
+
+/*! Cuts every ancestor that is depth generations behind an individual in the
+ population off from its own parents; older ancestors are released once
+ nothing else refers to them.  Returns the number of ancestors cut off.
+
+ Offspring still being evaluated (see inflight_offspring) count as part of
+ the population, as their evaluations may be walking their lines of descent
+ on worker threads.  Such a walk reads the parents of each of its
+ DELAY_GENERATIONS ancestors, so depth must be greater than that for the
+ cut-off ancestors to be out of its reach.
+ */
+template <typename EA>
+std::size_t truncate_lod(EA& ea, std::size_t depth) {
+    typedef typename EA::individual_type individual_type;
+    typedef typename EA::population_type population_type;
+    std::unordered_set<individual_type*> seen;
+    std::vector<individual_type*> generation, next;
+    for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
+        if(seen.insert(&*i).second) {
+            generation.push_back(&*i);
+        }
+    }
+    population_type& inflight=inflight_offspring(ea);
+    for(typename population_type::iterator i=inflight.begin(); i!=inflight.end(); ++i) {
+        if(seen.insert(&**i).second) {
+            generation.push_back(&**i);
+        }
+    }
+    for(std::size_t d=0; (d<depth) && !generation.empty(); ++d) {
+        next.clear();
+        for(std::size_t k=0; k<generation.size(); ++k) {
+            for(typename EA::population_type::iterator j=generation[k]->traits().lod_parents().begin(); j!=generation[k]->traits().lod_parents().end(); ++j) {
+                if(seen.insert(&**j).second) {
+                    next.push_back(&**j);
+                }
+            }
+        }
+        generation.swap(next);
+    }
+    std::size_t cut=0;
+    for(std::size_t k=0; k<generation.size(); ++k) {
+        if(generation[k]->traits().has_parents()) {
+            generation[k]->traits().lod_clear();
+            ++cut;
+        }
+    }
+    return cut;
+}
+
+} // memory
+
+/*! Datafile of memory use per component, in MB: resident set size,
+ population, line of descent (and its number of ancestors), dominant archive,
+ statistics buffers, all genomes, and the unaccounted rest.  Rows are written
+ every RECORDING_PERIOD updates.
+
+ If MEMORY_BUDGET is set, the resident set size is checked every update, and
+ while it exceeds the budget, buffers and archives are asked to compact
+ themselves and the line of descent is truncated to MEMORY_LOD_DEPTH
+ ancestors (default 64, and never fewer than DELAY_GENERATIONS+1).  Set the
+ budget somewhat below the run's mem_request, so that pruning happens before
+ the run is killed.  Truncating the line of descent loses the oldest part of
+ the lineage for later analysis.
+ */
+template <typename EA>
+struct memory_accounting {
+    memory_accounting(EA& ea) : _lod_truncations(0), _compactions(0), _df("memory.dat") {
+        _df.add_field("update")
+        .add_field("rss_mb")
+        .add_field("population_mb")
+        .add_field("lod_mb")
+        .add_field("lod_ancestors")
+        .add_field("archive_mb")
+        .add_field("buffers_mb")
+        .add_field("genomes_mb")
+        .add_field("other_mb")
+        .add_field("lod_truncations")
+        .add_field("compactions");
+    }
+
+    void end_of_update(EA& ea) {
+        double budget=get<MEMORY_BUDGET>(ea, 0.0);
+        if((budget <= 0.0) || (metrics::rss_bytes() <= (budget * 1048576.0))) {
+            return;
+        }
+        ++memory::compaction_epoch();
+        ++_compactions;
+        // the delay walks DELAY_GENERATIONS ancestors, and reads the parents of the last:
+        int depth=std::max(get<MEMORY_LOD_DEPTH>(ea, 64), get<DELAY_GENERATIONS>(ea, 0) + 1);
+        if(memory::truncate_lod(ea, static_cast<std::size_t>(depth)) > 0) {
+            ++_lod_truncations;
+        }
+    }
+
+    void record_statistics(EA& ea) {
+        const double MB=1048576.0;
+        memory::footprint<EA> f(ea);
+        double rss=metrics::rss_bytes();
+        double archive=memory::live(memory::ARCHIVE);
+        double buffers=memory::live(memory::BUFFERS);
+        _df.write(ea.current_update())
+        .write(rss / MB)
+        .write(f.population / MB)
+        .write(f.lod / MB)
+        .write(f.ancestors)
+        .write(archive / MB)
+        .write(buffers / MB)
+        .write(memory::live(memory::GENOMES) / MB)
+        .write(std::max(0.0, rss - f.population - f.lod - archive - buffers) / MB)
+        .write(_lod_truncations)
+        .write(_compactions)
+        .endl();
+    }
+
+    std::size_t _lod_truncations; //!< Updates at which the line of descent was truncated.
+    std::size_t _compactions; //!< Compactions requested.
+    datafile _df;
+};
+
+#endif
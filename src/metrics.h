@@ -0,0 +1,232 @@
+/* metrics.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <ea/metadata.h>
+
+using namespace ealib;
+
+//! Name of the shared-memory metrics segment (e.g., /himalaya-1); empty disables live metrics.
+LIBEA_MD_DECL(METRICS_SHM, "metrics.shm", std::string);
+//! If set, the metrics segment is left in place when the run exits.
+LIBEA_MD_DECL(METRICS_KEEP, "metrics.keep", int);
+//! Updates between samples of the resident set size (default 64).
+LIBEA_MD_DECL(METRICS_RSS_PERIOD, "metrics.rss_period", int);
+
+/* Live metrics, published through a POSIX shared-memory ring buffer.
+
+ The segment holds a header, naming up to MAX_FIELDS gauges, followed by
+ CAPACITY records of one value per gauge.  A single writer (the EA) fills one
+ record per update; any number of readers (see metrics_reader.cpp) may map the
+ segment read-only and poll it.  Nothing blocks: each record is guarded by a
+ sequence number that is odd while the record is being written, and readers
+ retry (or skip) records whose sequence number changed while they read them.
+ The segment is removed when the run exits, unless METRICS_KEEP is set;
+ readers that have already mapped it can still read it.
+ */
+
+namespace metrics {
+
+enum { MAX_FIELDS=32, NAME_SIZE=32, CAPACITY=1024 };
+
+//! Segment header.
+struct header {
+    char magic[8]; //!< "HIMMET1".
+    boost::uint32_t nfields; //!< Number of gauges per record.
+    boost::uint32_t capacity; //!< Number of records in the ring.
+    std::atomic<boost::uint64_t> head; //!< Number of records written so far.
+    char names[MAX_FIELDS][NAME_SIZE]; //!< Gauge names.
+};
+
+//! One record of the ring.
+struct record {
+    std::atomic<boost::uint64_t> seq; //!< 2n+1 while record n is being written, 2n+2 once it is complete.
+    double values[MAX_FIELDS]; //!< Gauge values.
+};
+
+//! Returns the size of a metrics segment.
+inline std::size_t segment_size() {
+    return sizeof(header) + CAPACITY * sizeof(record);
+}
+
+//! Returns the i'th record of the segment starting at h.
+inline record* record_at(header* h, boost::uint64_t i) {
+    return reinterpret_cast<record*>(h+1) + (i % h->capacity);
+}
+
+/*! Copies record n into values, returning false if it is not available (not
+ yet written, overwritten, or being written).
+ */
+inline bool read(header* h, boost::uint64_t n, double* values) {
+    record* r=record_at(h, n);
+    boost::uint64_t s=r->seq.load(std::memory_order_acquire);
+    if(s != (2*n + 2)) {
+        return false;
+    }
+    std::memcpy(values, r->values, h->nfields * sizeof(double));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return r->seq.load(std::memory_order_relaxed) == s;
+}
+
+/*! Writer side of a metrics segment.
+ */
+class writer {
+public:
+    /*! Constructor; creates (or replaces) the segment called name, which is
+     removed again by the destructor unless keep is set.
+     */
+    writer(const std::string& name, const std::vector<std::string>& fields, bool keep=false)
+    : _name(name), _keep(keep), _h(0) {
+        if(fields.size() > MAX_FIELDS) {
+            throw std::invalid_argument("metrics::writer: too many fields");
+        }
+        int fd=shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+        if(fd < 0) {
+            throw std::runtime_error("metrics::writer: could not open " + name);
+        }
+        if(ftruncate(fd, segment_size()) != 0) {
+            close(fd);
+            throw std::runtime_error("metrics::writer: could not size " + name);
+        }
+        void* p=mmap(0, segment_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(p == MAP_FAILED) {
+            throw std::runtime_error("metrics::writer: could not map " + name);
+        }
+
+        // the segment is zero-filled by ftruncate, which is a valid state for the atomics:
+        _h = static_cast<header*>(p);
+        _h->nfields = fields.size();
+        _h->capacity = CAPACITY;
+        for(std::size_t i=0; i<fields.size(); ++i) {
+            std::strncpy(_h->names[i], fields[i].c_str(), NAME_SIZE-1);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(_h->magic, "HIMMET1", 8);
+    }
+
+    //! Destructor; unmaps the segment, and removes it unless it is to be kept.
+    ~writer() {
+        munmap(_h, segment_size());
+        if(!_keep) {
+            shm_unlink(_name.c_str());
+        }
+    }
+
+    //! Publishes a record of nfields values.
+    void write(const double* values) {
+        boost::uint64_t n=_h->head.load(std::memory_order_relaxed);
+        record* r=record_at(_h, n);
+        r->seq.store(2*n + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(r->values, values, _h->nfields * sizeof(double));
+        r->seq.store(2*n + 2, std::memory_order_release);
+        _h->head.store(n+1, std::memory_order_release);
+    }
+
+protected:
+    std::string _name; //!< Name of the segment.
+    bool _keep; //!< If true, the segment outlives the writer.
+    header* _h; //!< Mapped segment.
+};
+
+//! Returns the resident set size of this process, in bytes.
+inline double rss_bytes() {
+    long pages=0, resident=0;
+    FILE* f=std::fopen("/proc/self/statm", "r");
+    if(f != 0) {
+        if(std::fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        std::fclose(f);
+    }
+    return static_cast<double>(resident) * sysconf(_SC_PAGESIZE);
+}
+
+/*! Resident set size, read through rss_bytes() on every period'th call and
+ cached in between, so that per-update gauges do not read /proc every update.
+ */
+class rss_sampler {
+public:
+    rss_sampler(int period) : _period(std::max(period, 1)), _calls(0), _rss(0.0) {
+    }
+
+    //! Returns the most recent sample, taking a new one if it is due.
+    double operator()() {
+        if((_calls++ % _period) == 0) {
+            _rss = rss_bytes();
+        }
+        return _rss;
+    }
+
+protected:
+    unsigned _period; //!< Calls between samples.
+    unsigned long _calls; //!< Calls so far.
+    double _rss; //!< Most recent sample.
+};
+
+/*! Counts fitness evaluations, and reports the rate since the last call to
+ rate().
+ */
+template <typename EA>
+struct evaluation_counter {
+    evaluation_counter(EA& ea) : n(0), _last_n(0), _last(clock::now()) {
+    }
+
+    void fitness_evaluated(typename EA::individual_type& ind, EA& ea) {
+        ++n;
+    }
+
+    //! Returns evaluations per second since the last call.
+    double rate() {
+        clock::time_point t=clock::now();
+        double s=std::chrono::duration<double>(t - _last).count();
+        double r=(s > 0.0) ? (static_cast<double>(n - _last_n) / s) : 0.0;
+        _last = t;
+        _last_n = n;
+        return r;
+    }
+
+    typedef std::chrono::steady_clock clock;
+    boost::uint64_t n; //!< Evaluations so far.
+    boost::uint64_t _last_n; //!< Evaluations at the last call to rate().
+    clock::time_point _last; //!< Time of the last call to rate().
+};
+
+} // metrics
+
+#endif
@@ -0,0 +1,93 @@
+/* metrics_reader.cpp
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+/*! Displays the live metrics published by an EA (see metrics.h).
+
+ Usage: himalaya-metrics <segment> [-f]
+
+ Prints the most recent record, or with -f, follows the run and prints each
+ record as it is published.  Records that were overwritten before they could
+ be read are skipped.
+ */
+int main(int argc, char* argv[]) {
+    if(argc < 2) {
+        std::fprintf(stderr, "usage: %s <segment> [-f]\n", argv[0]);
+        return 1;
+    }
+    bool follow=(argc > 2) && (std::strcmp(argv[2], "-f") == 0);
+
+    int fd=shm_open(argv[1], O_RDONLY, 0);
+    if(fd < 0) {
+        std::fprintf(stderr, "%s: could not open %s\n", argv[0], argv[1]);
+        return 1;
+    }
+    void* p=mmap(0, metrics::segment_size(), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) {
+        std::fprintf(stderr, "%s: could not map %s\n", argv[0], argv[1]);
+        return 1;
+    }
+    metrics::header* h=static_cast<metrics::header*>(p);
+    if(std::strncmp(h->magic, "HIMMET1", 8) != 0) {
+        std::fprintf(stderr, "%s: %s is not a metrics segment\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    for(boost::uint32_t i=0; i<h->nfields; ++i) {
+        std::printf("%s%s", (i ? "\t" : ""), h->names[i]);
+    }
+    std::printf("\n");
+
+    std::vector<double> values(h->nfields);
+    boost::uint64_t head=h->head.load(std::memory_order_acquire);
+    boost::uint64_t next=(follow || (head == 0)) ? head : (head-1);
+    do {
+        head = h->head.load(std::memory_order_acquire);
+        if((head - next) > h->capacity) {
+            next = head - h->capacity;
+        }
+        for( ; next<head; ++next) {
+            if(!metrics::read(h, next, &values[0])) {
+                continue;
+            }
+            for(std::size_t i=0; i<values.size(); ++i) {
+                std::printf("%s%g", (i ? "\t" : ""), values[i]);
+            }
+            std::printf("\n");
+        }
+        std::fflush(stdout);
+        if(follow) {
+            usleep(200000);
+        }
+    } while(follow);
+
+    munmap(p, metrics::segment_size());
+    return 0;
+}
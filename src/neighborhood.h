@@ -0,0 +1,222 @@
+/* neighborhood.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _NEIGHBORHOOD_H_
+#define _NEIGHBORHOOD_H_
+
+#include <algorithm>
+#include <vector>
+
+#include <ea/metadata.h>
+#include <ea/datafile.h>
+
+#include "hashed_nk_model.h"
+#include "packed_bitstring.h"
+#include "statistics.h"
+
+using namespace ealib;
+
+//! Maximum number of steps taken by hill climbs in the landscape datafile (0 disables climbing).
+LIBEA_MD_DECL(NEIGHBORHOOD_CLIMB_STEPS, "neighborhood.climb_steps", int);
+
+//! Flips bit i of a packed bitstring.
+inline void flip_bit(packed_bitstring& g, std::size_t i) {
+    g.flip(i);
+}
+
+//! Flips bit i of any other bitstring.
+template <typename Genome>
+void flip_bit(Genome& g, std::size_t i) {
+    g[i] = g[i] ? 0 : 1;
+}
+
+/*! The one-mutant neighborhood of a genome on a hashed NK landscape.
+
+ Flipping bit j changes the neighborhoods of the K+1 loci j-K..j, so the
+ fitness change of every single-bit flip can be computed from each locus'
+ current contribution and its K+1 one-bit variants: N(K+2) contribution
+ hashes in all, with no full evaluations.  After a flip, only the deltas of
+ the 2K+1 loci around it change, which makes steepest-ascent hill climbing
+ O(K^2) per step.
+
+ The object holds scratch space for one genome at a time, so each thread
+ should use its own.
+ */
+class nk_neighborhood {
+public:
+    typedef hashed_nk_model::key_type key_type;
+
+    //! Position of a genome relative to its neighbors.
+    enum position { PEAK, PLATEAU, SLOPE };
+
+    //! Scans the neighborhood of g, returning its fitness.
+    template <typename Genome>
+    double scan(const hashed_nk_model& m, const Genome& g) {
+        _n = m.n();
+        _k = m.k();
+        _x.resize(_n);
+        _c.resize(_n);
+        _d.resize(_n);
+        for(std::size_t i=0; i<_n; ++i) {
+            _x[i] = m.neighborhood(g, i);
+            _c[i] = m.contribution(i, _x[i]);
+        }
+        for(std::size_t j=0; j<_n; ++j) {
+            _d[j] = delta(m, j);
+        }
+        return fitness();
+    }
+
+    //! Returns the fitness of the scanned genome.
+    double fitness() const {
+        return _c.empty() ? 0.0 : (statistics::sum(&_c[0], _n) / static_cast<double>(_n));
+    }
+
+    //! Returns the change in fitness caused by flipping each bit.
+    const std::vector<double>& deltas() const { return _d; }
+
+    //! Returns the locus whose flip increases fitness the most.
+    std::size_t best() const {
+        return std::max_element(_d.begin(), _d.end()) - _d.begin();
+    }
+
+    //! Classifies the scanned genome as a strict peak, a plateau (no better neighbor, but an equal one), or a slope.
+    position classify(double epsilon=1e-12) const {
+        double d=_d[best()];
+        if(d > epsilon) {
+            return SLOPE;
+        }
+        return (d >= -epsilon) ? PLATEAU : PEAK;
+    }
+
+    //! Moves to the neighbor that differs at bit j, updating the deltas incrementally.
+    void flip(const hashed_nk_model& m, std::size_t j) {
+        for(std::size_t b=0; b<=_k; ++b) {
+            std::size_t i=(j + _n - b) % _n;
+            _x[i] ^= key_type(1) << b;
+            _c[i] = m.contribution(i, _x[i]);
+        }
+        if((2*_k + 1) >= _n) {
+            for(std::size_t l=0; l<_n; ++l) {
+                _d[l] = delta(m, l);
+            }
+        } else {
+            for(std::size_t o=0; o<=(2*_k); ++o) {
+                std::size_t l=(j + _n - _k + o) % _n;
+                _d[l] = delta(m, l);
+            }
+        }
+    }
+
+    /*! Steepest-ascent hill climbing from g, for at most max_steps steps.
+
+     g is modified in place, and ends on a peak or plateau unless the step
+     limit is reached.  Returns the number of steps taken.
+     */
+    template <typename Genome>
+    std::size_t hill_climb(const hashed_nk_model& m, Genome& g, std::size_t max_steps) {
+        scan(m, g);
+        std::size_t steps=0;
+        for( ; steps<max_steps; ++steps) {
+            std::size_t j=best();
+            if(_d[j] <= 0.0) {
+                break;
+            }
+            flip_bit(g, j);
+            flip(m, j);
+        }
+        return steps;
+    }
+
+protected:
+    //! Returns the change in fitness caused by flipping bit j.
+    double delta(const hashed_nk_model& m, std::size_t j) const {
+        double d=0.0;
+        for(std::size_t b=0; b<=_k; ++b) {
+            std::size_t i=(j + _n - b) % _n;
+            d += m.contribution(i, _x[i] ^ (key_type(1) << b)) - _c[i];
+        }
+        return d / static_cast<double>(_n);
+    }
+
+    std::size_t _n; //!< Number of loci.
+    std::size_t _k; //!< Epistatic neighbors per locus.
+    std::vector<key_type> _x; //!< Neighborhood bits of each locus.
+    std::vector<double> _c; //!< Contribution of each locus.
+    std::vector<double> _d; //!< Fitness change of flipping each bit.
+};
+
+/*! Datafile for the landscape position of the population: the fraction of
+ individuals on peaks, plateaus and slopes, and the mean best one-bit
+ improvement.  If NEIGHBORHOOD_CLIMB_STEPS is set, each individual is also
+ hill climbed (on a copy of its genome), and the mean number of steps and
+ fitness gained are recorded as well.
+
+ Requires the EA's fitness function to be (or derive from) hashed_nk_model.
+ */
+template <typename EA>
+struct landscape_position {
+    landscape_position(EA& ea) : _df("landscape.dat") {
+        _df.add_field("update")
+        .add_field("peaks")
+        .add_field("plateaus")
+        .add_field("slopes")
+        .add_field("mean_best_delta")
+        .add_field("mean_climb_steps")
+        .add_field("mean_climb_gain");
+    }
+
+    void record_statistics(EA& ea) {
+        const hashed_nk_model& m=ea.fitness_function();
+        std::size_t max_steps=get<NEIGHBORHOOD_CLIMB_STEPS>(ea, 0);
+        double count[3]={0.0, 0.0, 0.0};
+        _best.clear();
+        _steps.clear();
+        _gain.clear();
+        for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
+            double w=_scan.scan(m, i->genome());
+            ++count[_scan.classify()];
+            _best.push_back(_scan.deltas()[_scan.best()]);
+            if(max_steps > 0) {
+                _g = i->genome();
+                _steps.push_back(_scan.hill_climb(m, _g, max_steps));
+                _gain.push_back(_scan.fitness() - w);
+            }
+        }
+
+        double n=std::max(1.0, count[0] + count[1] + count[2]);
+        _df.write(ea.current_update())
+        .write(count[nk_neighborhood::PEAK] / n)
+        .write(count[nk_neighborhood::PLATEAU] / n)
+        .write(count[nk_neighborhood::SLOPE] / n)
+        .write(_best.mean())
+        .write(_steps.mean())
+        .write(_gain.mean())
+        .endl();
+    }
+
+    nk_neighborhood _scan; //!< Neighborhood scanner.
+    typename EA::genome_type _g; //!< Scratch genome for hill climbing.
+    statistics::sample _best; //!< Best one-bit improvement of each individual.
+    statistics::sample _steps; //!< Hill-climbing steps of each individual.
+    statistics::sample _gain; //!< Hill-climbing fitness gain of each individual.
+    datafile _df;
+};
+
+#endif
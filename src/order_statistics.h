@@ -0,0 +1,258 @@
+/* order_statistics.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _ORDER_STATISTICS_H_
+#define _ORDER_STATISTICS_H_
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+/*! Indexed skip list: a sorted multiset of (key, value) pairs that also
+ answers order-statistic queries.
+
+ Insertion, removal, select(i) (the i'th smallest key) and rank(k) (the number
+ of keys less than k) all take O(log n) expected time; front() takes O(1).
+ Each link records how many elements it skips, which is what makes select and
+ rank logarithmic (Pugh, "A skip list cookbook", 1990).
+
+ Node levels are drawn from a private xorshift generator, so using a skip list
+ draws nothing from the EA's random number generator, and the shape of the
+ list (but never its contents or the answers to queries) depends only on the
+ sequence of operations.  Keys must be unique for erase() to remove a
+ particular element; ties are usually broken by including a name in the key.
+ */
+template <typename Key, typename Value, typename Compare=std::less<Key> >
+class indexed_skiplist {
+public:
+    enum { MAX_LEVEL=16 }; //!< Enough for 4^16 elements at p=1/4.
+
+    //! Constructor.
+    indexed_skiplist() : _size(0), _level(1), _state(0x9e3779b97f4a7c15ULL) {
+        _head.next.assign(MAX_LEVEL, 0);
+        _head.width.assign(MAX_LEVEL, 1);
+    }
+
+    //! Copy constructor.
+    indexed_skiplist(const indexed_skiplist& that) : _size(0), _level(1), _state(that._state), _compare(that._compare) {
+        _head.next.assign(MAX_LEVEL, 0);
+        _head.width.assign(MAX_LEVEL, 1);
+        that.for_each([this](const Key& k, const Value& v) { insert(k, v); });
+    }
+
+    //! Assignment operator.
+    indexed_skiplist& operator=(const indexed_skiplist& that) {
+        if(this != &that) {
+            clear();
+            that.for_each([this](const Key& k, const Value& v) { insert(k, v); });
+        }
+        return *this;
+    }
+
+    //! Destructor.
+    ~indexed_skiplist() {
+        clear();
+    }
+
+    //! Returns the number of elements.
+    std::size_t size() const { return _size; }
+
+    //! Returns true if there are no elements.
+    bool empty() const { return _size == 0; }
+
+    //! Removes all elements.
+    void clear() {
+        node* x=_head.next[0];
+        while(x != 0) {
+            node* n=x->next[0];
+            delete x;
+            x = n;
+        }
+        _head.next.assign(MAX_LEVEL, 0);
+        _head.width.assign(MAX_LEVEL, 1);
+        _size = 0;
+        _level = 1;
+    }
+
+    //! Inserts (k, v).
+    void insert(const Key& k, const Value& v) {
+        node* update[MAX_LEVEL];
+        std::size_t rank[MAX_LEVEL];
+        find(k, update, rank);
+
+        std::size_t lvl=random_level();
+        if(lvl > _level) {
+            for(std::size_t l=_level; l<lvl; ++l) {
+                update[l] = &_head;
+                rank[l] = 0;
+                _head.width[l] = _size + 1;
+            }
+            _level = lvl;
+        }
+
+        node* n=new node(k, v, lvl);
+        for(std::size_t l=0; l<lvl; ++l) {
+            std::size_t d=rank[0] + 1 - rank[l]; // steps from update[l] to n
+            n->next[l] = update[l]->next[l];
+            n->width[l] = update[l]->width[l] + 1 - d;
+            update[l]->next[l] = n;
+            update[l]->width[l] = d;
+        }
+        for(std::size_t l=lvl; l<_level; ++l) {
+            ++update[l]->width[l];
+        }
+        ++_size;
+    }
+
+    //! Removes the element with key k; returns false if there is none.
+    bool erase(const Key& k) {
+        node* update[MAX_LEVEL];
+        std::size_t rank[MAX_LEVEL];
+        find(k, update, rank);
+        node* x=update[0]->next[0];
+        if((x == 0) || _compare(k, x->key)) {
+            return false;
+        }
+        unlink(x, update);
+        return true;
+    }
+
+    //! Returns the number of keys less than k.
+    std::size_t rank(const Key& k) const {
+        const node* x=&_head;
+        std::size_t pos=0;
+        for(std::size_t l=_level; l>0; --l) {
+            while((x->next[l-1] != 0) && _compare(x->next[l-1]->key, k)) {
+                pos += x->width[l-1];
+                x = x->next[l-1];
+            }
+        }
+        return pos;
+    }
+
+    //! Returns the i'th smallest (key, value) pair, counting from 0.
+    std::pair<const Key&, const Value&> select(std::size_t i) const {
+        assert(i < _size);
+        const node* x=&_head;
+        std::size_t pos=0;
+        for(std::size_t l=_level; l>0; --l) {
+            while((x->next[l-1] != 0) && ((pos + x->width[l-1]) <= (i + 1))) {
+                pos += x->width[l-1];
+                x = x->next[l-1];
+            }
+        }
+        return std::pair<const Key&, const Value&>(x->key, x->value);
+    }
+
+    //! Returns the smallest (key, value) pair.
+    std::pair<const Key&, const Value&> front() const {
+        assert(_size > 0);
+        return std::pair<const Key&, const Value&>(_head.next[0]->key, _head.next[0]->value);
+    }
+
+    //! Returns the largest (key, value) pair.
+    std::pair<const Key&, const Value&> back() const {
+        return select(_size - 1);
+    }
+
+    //! Removes the smallest element.
+    void pop_front() {
+        assert(_size > 0);
+        node* update[MAX_LEVEL];
+        for(std::size_t l=0; l<_level; ++l) {
+            update[l] = &_head;
+        }
+        unlink(_head.next[0], update);
+    }
+
+    //! Calls f(key, value) for each element, smallest first.
+    template <typename F>
+    void for_each(F f) const {
+        for(const node* x=_head.next[0]; x!=0; x=x->next[0]) {
+            f(x->key, x->value);
+        }
+    }
+
+protected:
+    //! Element, with its forward links and how many elements each skips.
+    struct node {
+        node() { }
+        node(const Key& k, const Value& v, std::size_t lvl) : key(k), value(v), next(lvl, 0), width(lvl, 1) { }
+        Key key;
+        Value value;
+        std::vector<node*> next;
+        std::vector<std::size_t> width;
+    };
+
+    //! Finds the last node before k on each level, and its position.
+    void find(const Key& k, node** update, std::size_t* rank) {
+        node* x=&_head;
+        std::size_t pos=0;
+        for(std::size_t l=_level; l>0; --l) {
+            while((x->next[l-1] != 0) && _compare(x->next[l-1]->key, k)) {
+                pos += x->width[l-1];
+                x = x->next[l-1];
+            }
+            update[l-1] = x;
+            rank[l-1] = pos;
+        }
+    }
+
+    //! Removes x, given the last node before it on each level.
+    void unlink(node* x, node** update) {
+        for(std::size_t l=0; l<_level; ++l) {
+            if(update[l]->next[l] == x) {
+                update[l]->width[l] += x->width[l] - 1;
+                update[l]->next[l] = x->next[l];
+            } else {
+                --update[l]->width[l];
+            }
+        }
+        while((_level > 1) && (_head.next[_level-1] == 0)) {
+            --_level;
+        }
+        delete x;
+        --_size;
+    }
+
+    //! Returns a level in [1, MAX_LEVEL], each one a quarter as likely as the last.
+    std::size_t random_level() {
+        _state ^= _state << 13;
+        _state ^= _state >> 7;
+        _state ^= _state << 17;
+        boost::uint64_t r=_state;
+        std::size_t lvl=1;
+        while(((r & 3) == 0) && (lvl < MAX_LEVEL)) {
+            ++lvl;
+            r >>= 2;
+        }
+        return lvl;
+    }
+
+    node _head; //!< Sentinel before the first element.
+    std::size_t _size; //!< Number of elements.
+    std::size_t _level; //!< Number of levels in use.
+    boost::uint64_t _state; //!< Level generator state.
+    Compare _compare; //!< Key ordering.
+};
+
+#endif
@@ -0,0 +1,536 @@
+/* packed_bitstring.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _PACKED_BITSTRING_H_
+#define _PACKED_BITSTRING_H_
+
+#include <cmath>
+#include <cassert>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <boost/cstdint.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/string.hpp>
+
+#include <ea/metadata.h>
+#include <ea/mutation.h>
+
+#include "counter_rng.h"
+#include "interning.h"
+#include "counting_allocator.h"
+
+using namespace ealib;
+
+/*! Bitstring genome that stores 64 loci per machine word.
+
+ This is a drop-in replacement for bitstring (a vector of ints) as far as
+ ancestor generation and fitness functions are concerned: elements are read
+ and written as ints through operator[] and the iterators, so that
+ ancestors::random_bitstring and nk_model work unmodified.  The variation
+ operators below, however, work on whole words at a time.
+
+ Bits beyond size() in the last word are always zero.
+
+ Words are stored copy-on-write: copies of a bitstring share its words until
+ one of them is modified.  intern() further replaces the words with the
+ shared copy of all equal bitstrings (see intern_pool), which is what
+ genome_interning does once a genome has been evaluated, so that identical
+ genomes in the population, the line of descent and the archives are held
+ once.  Two interned bitstrings are equal only if they share their words, so
+ comparing them is O(1).  Reading bits (including through the proxies) never
+ copies; only modifying them does.
+ */
+class packed_bitstring {
+public:
+    typedef boost::uint64_t word_type;
+    typedef int value_type;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef std::vector<word_type, memory::counting_allocator<word_type, memory::GENOMES> > word_vector;
+
+    static const size_type word_bits=64;
+
+    //! Proxy reference to a single bit; copies the words only when written.
+    class reference {
+    public:
+        reference(packed_bitstring* g, size_type i) : _g(g), _i(i) {
+        }
+
+        operator int() const { return static_cast<const packed_bitstring&>(*_g)[_i]; }
+
+        reference& operator=(int v) {
+            word_type& w=_g->words()[_i/word_bits];
+            word_type m=word_type(1) << (_i%word_bits);
+            if(v) { w |= m; } else { w &= ~m; }
+            return *this;
+        }
+
+        reference& operator=(const reference& that) {
+            return *this = static_cast<int>(that);
+        }
+
+        reference& operator^=(int v) {
+            if(v & 0x01) { _g->flip(_i); }
+            return *this;
+        }
+
+    protected:
+        packed_bitstring* _g; //!< Bitstring holding this bit.
+        size_type _i; //!< Index of this bit.
+    };
+
+    //! Random-access iterator over bits, dereferencing to a proxy.
+    class iterator : public boost::iterator_facade<iterator, int, boost::random_access_traversal_tag, reference> {
+    public:
+        iterator() : _g(0), _i(0) { }
+        iterator(packed_bitstring* g, size_type i) : _g(g), _i(i) { }
+    protected:
+        friend class boost::iterator_core_access;
+        friend class packed_bitstring;
+        reference dereference() const { return reference(_g, _i); }
+        bool equal(const iterator& that) const { return _i == that._i; }
+        void increment() { ++_i; }
+        void decrement() { --_i; }
+        void advance(difference_type n) { _i += n; }
+        difference_type distance_to(const iterator& that) const { return static_cast<difference_type>(that._i) - static_cast<difference_type>(_i); }
+        packed_bitstring* _g;
+        size_type _i;
+    };
+
+    //! Random-access iterator over bits, dereferencing to an int.
+    class const_iterator : public boost::iterator_facade<const_iterator, const int, boost::random_access_traversal_tag, int> {
+    public:
+        const_iterator() : _w(0), _i(0) { }
+        const_iterator(const word_type* w, size_type i) : _w(w), _i(i) { }
+        const_iterator(const iterator& that) : _w(that._g ? that._g->cdata() : 0), _i(that._i) { }
+    protected:
+        friend class boost::iterator_core_access;
+        int dereference() const { return (_w[_i/word_bits] >> (_i%word_bits)) & 0x01; }
+        bool equal(const const_iterator& that) const { return _i == that._i; }
+        void increment() { ++_i; }
+        void decrement() { --_i; }
+        void advance(difference_type n) { _i += n; }
+        difference_type distance_to(const const_iterator& that) const { return static_cast<difference_type>(that._i) - static_cast<difference_type>(_i); }
+        const word_type* _w;
+        size_type _i;
+    };
+
+    //! Constructs an empty bitstring.
+    packed_bitstring() : _size(0), _interned(false) {
+    }
+
+    //! Constructs a bitstring of n bits, all set to v.
+    explicit packed_bitstring(size_type n, int v=0) : _size(0), _interned(false) {
+        resize(n, v);
+    }
+
+    //! Returns the number of bits.
+    size_type size() const { return _size; }
+
+    //! Returns true if there are no bits.
+    bool empty() const { return _size == 0; }
+
+    //! Resizes to n bits; new bits are set to v.
+    void resize(size_type n, int v=0) {
+        if((n == _size) && !v) {
+            return;
+        }
+        size_type old=_size;
+        word_vector& w=words();
+        _size = n;
+        w.resize(nwords(n), v ? ~word_type(0) : word_type(0));
+        if(v && (old < n) && (old % word_bits)) {
+            w[old/word_bits] |= ~word_type(0) << (old % word_bits);
+        }
+        mask_tail();
+    }
+
+    //! Removes all bits.
+    void clear() { _size = 0; _words.reset(); _interned = false; }
+
+    //! Returns the value of bit i.
+    int operator[](size_type i) const { return (cdata()[i/word_bits] >> (i%word_bits)) & 0x01; }
+
+    /*! Returns the n (<= 64) bits starting at pos, with bit pos in the least
+     significant position.  Requires pos+n <= size().
+     */
+    word_type bits(size_type pos, size_type n) const {
+        const word_type* d=cdata();
+        size_type w=pos/word_bits, b=pos%word_bits;
+        word_type x=d[w] >> b;
+        if((b + n) > word_bits) {
+            x |= d[w+1] << (word_bits - b);
+        }
+        return (n < word_bits) ? (x & ((word_type(1) << n) - 1)) : x;
+    }
+
+    //! Returns a proxy reference to bit i.
+    reference operator[](size_type i) { return reference(this, i); }
+
+    //! Flip bit i.
+    void flip(size_type i) { words()[i/word_bits] ^= word_type(1) << (i%word_bits); }
+
+    //! Returns the number of set bits.
+    size_type count() const {
+        const word_vector& w=words();
+        size_type c=0;
+        for(std::size_t i=0; i<w.size(); ++i) {
+            c += popcount(w[i]);
+        }
+        return c;
+    }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, _size); }
+    const_iterator begin() const { return const_iterator(cdata(), 0); }
+    const_iterator end() const { return const_iterator(cdata(), _size); }
+
+    //! Returns the underlying words, first making them private to this bitstring.
+    word_vector& words() {
+        if(!_words) {
+            _words = std::make_shared<word_vector>();
+        } else if(_interned || (_words.use_count() > 1)) {
+            _words = std::make_shared<word_vector>(*_words);
+        }
+        _interned = false;
+        return const_cast<word_vector&>(*_words);
+    }
+
+    //! Returns the underlying words (const-qualified).
+    const word_vector& words() const { return _words ? *_words : no_words(); }
+
+    //! Clears any bits in the last word beyond size().
+    void mask_tail() {
+        if(_size % word_bits) {
+            words().back() &= tail_mask(_size);
+        }
+    }
+
+    //! Replaces the words with the shared copy of all bitstrings equal to this one.
+    void intern() {
+        if(!_interned && _words) {
+            _words = pool_type::instance().intern(*_words);
+            _interned = true;
+        }
+    }
+
+    //! Returns true if this bitstring is interned.
+    bool interned() const { return _interned; }
+
+    //! Returns the number of bitstrings sharing these words.
+    long shares() const { return _words ? _words.use_count() : 1; }
+
+    bool operator==(const packed_bitstring& that) const {
+        if(_size != that._size) {
+            return false;
+        }
+        if(_words == that._words) {
+            return true;
+        }
+        if(_interned && that._interned) {
+            return false;
+        }
+        return words() == that.words();
+    }
+
+    bool operator!=(const packed_bitstring& that) const {
+        return !(*this == that);
+    }
+
+    bool operator<(const packed_bitstring& that) const {
+        return (_size < that._size) || ((_size == that._size) && (words() < that.words()));
+    }
+
+    //! Returns the number of words needed to hold n bits.
+    static size_type nwords(size_type n) { return (n + word_bits - 1) / word_bits; }
+
+    //! Returns a mask of the valid bits in the last word of an n-bit string.
+    static word_type tail_mask(size_type n) {
+        return (n % word_bits) ? ((word_type(1) << (n % word_bits)) - 1) : ~word_type(0);
+    }
+
+    //! Returns a mask of the bits in [first,last) of a single word (last <= 64).
+    static word_type range_mask(size_type first, size_type last) {
+        word_type hi = (last >= word_bits) ? ~word_type(0) : ((word_type(1) << last) - 1);
+        return hi & (~word_type(0) << first);
+    }
+
+    //! Returns the number of set bits in w.
+    static size_type popcount(word_type w) {
+#if defined(__GNUC__)
+        return __builtin_popcountll(w);
+#else
+        size_type c=0;
+        for( ; w; ++c) { w &= w - 1; }
+        return c;
+#endif
+    }
+
+protected:
+    //! Hash of a word vector, for interning.
+    struct word_hash {
+        std::size_t operator()(const word_vector& w) const {
+            boost::uint64_t h=0x9e3779b97f4a7c15ULL ^ w.size();
+            for(std::size_t i=0; i<w.size(); ++i) {
+                h = (h ^ w[i]) * 0xff51afd7ed558ccdULL;
+                h ^= h >> 32;
+            }
+            return static_cast<std::size_t>(h);
+        }
+    };
+
+    typedef intern_pool<word_vector, word_hash> pool_type;
+
+    //! Returns an empty word vector.
+    static const word_vector& no_words() {
+        static const word_vector e;
+        return e;
+    }
+
+    //! Returns the first word, or null; never copies.
+    const word_type* cdata() const { return (_words && !_words->empty()) ? &(*_words)[0] : 0; }
+
+    friend class boost::serialization::access;
+
+    //! Checkpoints store the bitstring as a string of '0' and '1'.
+    template <class Archive>
+    void save(Archive& ar, const unsigned int version) const {
+        std::string s(_size, '0');
+        for(size_type i=0; i<_size; ++i) {
+            if((*this)[i]) { s[i] = '1'; }
+        }
+        ar & boost::serialization::make_nvp("bits", s);
+    }
+
+    template <class Archive>
+    void load(Archive& ar, const unsigned int version) {
+        std::string s;
+        ar & boost::serialization::make_nvp("bits", s);
+        clear();
+        resize(s.size());
+        for(size_type i=0; i<_size; ++i) {
+            if(s[i] == '1') { flip(i); }
+        }
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER();
+
+    size_type _size; //!< Number of bits.
+    std::shared_ptr<const word_vector> _words; //!< Packed bits, shared copy-on-write; bit i lives in word i/64, position i%64.
+    bool _interned; //!< True if _words is interned.
+};
+
+//! Heap bytes held by a packed bitstring, divided among those sharing them (see memory.h).
+inline double genome_bytes(const packed_bitstring& g) {
+    return static_cast<double>(g.words().capacity() * sizeof(packed_bitstring::word_type)) / g.shares();
+}
+
+//! Interns g (see genome_interning).
+inline void intern_genome(packed_bitstring& g) {
+    g.intern();
+}
+
+/*! Returns the Hamming distance between two equal-length packed bitstrings.
+ */
+inline std::size_t hamming_distance(const packed_bitstring& a, const packed_bitstring& b) {
+    assert(a.size() == b.size());
+    const packed_bitstring::word_vector& x=a.words();
+    const packed_bitstring::word_vector& y=b.words();
+    std::size_t d=0;
+    for(std::size_t i=0; i<x.size(); ++i) {
+        d += packed_bitstring::popcount(x[i] ^ y[i]);
+    }
+    return d;
+}
+
+/*! Returns the number of failures before the first success of a Bernoulli
+ process with log(1-p) == lq, capped at n.
+ */
+template <typename RNG>
+std::size_t geometric_gap(double lq, std::size_t n, RNG& rng) {
+    double g=std::floor(std::log(1.0 - rng.uniform_real(0.0,1.0)) / lq);
+    return (g < static_cast<double>(n)) ? static_cast<std::size_t>(g) : n;
+}
+
+/*! Flip each bit of g with probability p.
+
+ Rather than drawing a random number per site, this samples the gaps between
+ mutated sites from the geometric distribution, builds an XOR mask a word at
+ a time, and applies it.  The result is distributed identically to the
+ per-site Bernoulli process.
+ */
+template <typename RNG>
+void per_site_bitflip(packed_bitstring& g, double p, RNG& rng) {
+    const std::size_t n=g.size();
+    if((p <= 0.0) || (n == 0)) {
+        return;
+    }
+
+    if(p >= 1.0) {
+        packed_bitstring::word_vector& w=g.words();
+        for(std::size_t i=0; i<w.size(); ++i) {
+            w[i] = ~w[i];
+        }
+        g.mask_tail();
+        return;
+    }
+
+    // each gap is the number of unmutated sites before the next mutation:
+    const double lq=std::log(1.0 - p);
+    const std::size_t wb=packed_bitstring::word_bits;
+    std::size_t i=geometric_gap(lq, n, rng);
+    if(i >= n) {
+        return; // no mutations; leave shared words shared
+    }
+    packed_bitstring::word_vector& w=g.words();
+    std::size_t wi=0;
+    packed_bitstring::word_type mask=0;
+    for( ; i<n; i+=1+geometric_gap(lq, n, rng)) {
+        if((i/wb) != wi) {
+            w[wi] ^= mask;
+            wi = i/wb;
+            mask = 0;
+        }
+        mask |= packed_bitstring::word_type(1) << (i%wb);
+    }
+    w[wi] ^= mask;
+}
+
+/*! Two-point crossover of packed bitstrings.
+
+ Sets o to a copy of a with the bits in [first,last) taken from b, blending
+ whole words under a mask.  If that changes nothing, o shares a's words.
+ */
+inline void two_point_blend(const packed_bitstring& a, const packed_bitstring& b,
+                            std::size_t first, std::size_t last, packed_bitstring& o) {
+    assert(a.size() == b.size());
+    o = a;
+    if(a == b) {
+        return;
+    }
+    const packed_bitstring::word_vector& x=a.words();
+    const packed_bitstring::word_vector& y=b.words();
+    packed_bitstring::word_vector* w=0;
+    const std::size_t wb=packed_bitstring::word_bits;
+    for(std::size_t i=first/wb; (i<x.size()) && (i*wb < last); ++i) {
+        std::size_t lo=std::max(first, i*wb) - i*wb;
+        std::size_t hi=std::min(last, (i+1)*wb) - i*wb;
+        packed_bitstring::word_type m=packed_bitstring::range_mask(lo, hi);
+        if((x[i] ^ y[i]) & m) {
+            if(w == 0) {
+                w = &o.words();
+            }
+            (*w)[i] = (x[i] & ~m) | (y[i] & m);
+        }
+    }
+}
+
+/*! Overwrite g with n random bits drawn from rng, reusing its storage.
+
+ Fills 16 bits per draw.
+ */
+template <typename RNG>
+void random_bits(packed_bitstring& g, std::size_t n, RNG& rng) {
+    g.resize(n);
+    packed_bitstring::word_vector& w=g.words();
+    for(std::size_t i=0; i<w.size(); ++i) {
+        w[i] = 0;
+        for(std::size_t j=0; j<packed_bitstring::word_bits; j+=16) {
+            packed_bitstring::word_type r=rng.uniform_integer(0, 0x10000);
+            w[i] |= (r & 0xffff) << j;
+        }
+    }
+    g.mask_tail();
+}
+
+/*! Overwrite g with n random bits drawn from a counter_rng stream, a whole
+ word per draw.
+ */
+inline void random_bits(packed_bitstring& g, std::size_t n, counter_rng& rng) {
+    g.resize(n);
+    packed_bitstring::word_vector& w=g.words();
+    for(std::size_t i=0; i<w.size(); ++i) {
+        w[i] = rng.next64();
+    }
+    g.mask_tail();
+}
+
+/*! Overwrite g with REPRESENTATION_SIZE random bits, reusing its storage.
+
+ Equivalent to ancestors::random_bitstring, but fills 16 bits per draw.
+ */
+template <typename EA>
+void random_genome(packed_bitstring& g, EA& ea) {
+    random_bits(g, get<REPRESENTATION_SIZE>(ea), ea.rng());
+}
+
+//! Overwrite g with REPRESENTATION_SIZE random bits drawn from rng.
+template <typename RNG, typename EA>
+void random_genome(packed_bitstring& g, RNG& rng, EA& ea) {
+    random_bits(g, get<REPRESENTATION_SIZE>(ea), rng);
+}
+
+/*! Per-site bitflip mutation for packed bitstrings.
+
+ Equivalent to mutation::operators::per_site<mutation::site::bitflip>, but
+ operates on whole words.
+ */
+struct packed_per_site_bitflip {
+    template <typename EA>
+    void operator()(typename EA::individual_type& ind, EA& ea) {
+        per_site_bitflip(ind.genome(), get<MUTATION_PER_SITE_P>(ea), ea.rng());
+    }
+
+    //! Mutate with per-site probability p, instead of MUTATION_PER_SITE_P.
+    template <typename EA>
+    void operator()(typename EA::individual_type& ind, double p, EA& ea) {
+        per_site_bitflip(ind.genome(), p, ea.rng());
+    }
+};
+
+/*! Two-point crossover for packed bitstrings.
+
+ Equivalent to recombination::two_point_crossover, but operates on whole words.
+ */
+struct packed_two_point_crossover {
+    //! Number of parents needed.
+    std::size_t capacity() const { return 2; }
+
+    //! Produce a single offspring from the first two parents.
+    template <typename Population, typename EA>
+    void operator()(Population& parents, Population& offspring, EA& ea) {
+        const packed_bitstring& p1=parents[0]->genome();
+        const packed_bitstring& p2=parents[1]->genome();
+
+        std::size_t first=ea.rng().uniform_integer(0, static_cast<int>(p1.size()));
+        std::size_t last=ea.rng().uniform_integer(0, static_cast<int>(p1.size()));
+        if(first > last) {
+            std::swap(first, last);
+        }
+
+        packed_bitstring o;
+        two_point_blend(p1, p2, first, last, o);
+        offspring.insert(offspring.end(), ea.make_individual(o));
+    }
+};
+
+#endif
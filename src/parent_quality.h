@@ -0,0 +1,285 @@
+/* parent_quality.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _PARENT_QUALITY_H_
+#define _PARENT_QUALITY_H_
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <ea/metadata.h>
+#include <ea/datafile.h>
+
+#include "delay.h"
+#include "statistics.h"
+
+using namespace ealib;
+
+//! Factor by which an offspring's heritable mutation scale moves each generation (0 disables it).
+LIBEA_MD_DECL(PARENT_QUALITY_MUTATION_STEP, "parent_quality.mutation_step", double);
+//! Heritable per-site mutation scale of an individual (a multiple of MUTATION_PER_SITE_P).
+LIBEA_MD_DECL(PARENT_QUALITY_MUTATION_SCALE, "parent_quality.mutation_scale", double);
+
+/* Parent quality: how much fitter (or less fit) an individual's offspring are
+ than it was when they were born.
+
+ The archived himalaya_inheritance event evaluated every offspring and parent
+ at birth, and kept its totals in metadata, which himalaya_datafile then
+ averaged over the population.  Here, nothing is evaluated that would not be
+ anyway:
+
+ - At birth (inheritance), each offspring records its parents' names and their
+ mean real fitness, as far as it is known (DELAY_W_REAL if present, otherwise
+ fitness; unevaluated parents are left out).
+
+ - When the offspring is evaluated (fitness_evaluated), delta_w = w_off -
+ w_parents is credited to each parent that is still alive.
+
+ - Population means of delta_w and of the number of evaluated offspring are
+ kept as running sums, updated on every credit and every death, so that
+ reporting them is O(1).
+
+ Records live in a table sharded by individual name, each shard with its own
+ mutex, so that breeders running on several threads can update it; deaths are
+ collected at the end of each update.
+ */
+
+namespace parent_quality {
+
+//! Per-individual record.
+struct record {
+    record() : acc_dw(0.0), n(0), scale(1.0), parent_w(0.0), nparents(0), pending(false), born(0) {
+        parents[0] = parents[1] = 0;
+    }
+
+    //! Returns the mean delta_w of this individual's offspring.
+    double mean_dw() const { return n ? (acc_dw / n) : 0.0; }
+
+    double acc_dw; //!< Sum of delta_w over evaluated offspring.
+    unsigned n; //!< Number of evaluated offspring.
+    double scale; //!< Heritable mutation scale.
+    long parents[2]; //!< Names of (up to two) parents.
+    double parent_w; //!< Mean real fitness of the parents at birth.
+    unsigned char nparents; //!< Number of parents whose fitness was known at birth.
+    bool pending; //!< True until this individual has been evaluated.
+    unsigned long born; //!< Update at which this individual was born.
+};
+
+/*! Table of records, sharded by name.
+ */
+class table {
+public:
+    enum { SHARDS=16 };
+
+    //! Shard of the table, with running sums over its records.
+    struct shard {
+        shard() : sum_mean_dw(0.0), sum_n(0.0) { }
+        std::mutex mutex;
+        std::unordered_map<long, record> records;
+        double sum_mean_dw; //!< Sum of mean_dw() over records.
+        double sum_n; //!< Sum of n over records.
+    };
+
+    //! Returns the shard holding name.
+    shard& at(long name) { return _shards[static_cast<unsigned long>(name) % SHARDS]; }
+
+    //! Credits delta_w to the individual called name, if it is still tracked.
+    void credit(long name, double dw) {
+        shard& s=at(name);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        std::unordered_map<long, record>::iterator i=s.records.find(name);
+        if(i == s.records.end()) {
+            return;
+        }
+        s.sum_mean_dw -= i->second.mean_dw();
+        i->second.acc_dw += dw;
+        ++i->second.n;
+        s.sum_mean_dw += i->second.mean_dw();
+        s.sum_n += 1.0;
+    }
+
+    //! Removes the records of individuals that are not alive and not born at update u.
+    void collect(const std::unordered_set<long>& alive, unsigned long u) {
+        for(std::size_t k=0; k<SHARDS; ++k) {
+            shard& s=_shards[k];
+            std::lock_guard<std::mutex> lock(s.mutex);
+            for(std::unordered_map<long, record>::iterator i=s.records.begin(); i!=s.records.end(); ) {
+                if((alive.count(i->first) == 0) && (i->second.born != u)) {
+                    s.sum_mean_dw -= i->second.mean_dw();
+                    s.sum_n -= i->second.n;
+                    i = s.records.erase(i);
+                } else {
+                    ++i;
+                }
+            }
+        }
+    }
+
+    //! Returns the sums of mean_dw() and n over all records.
+    std::pair<double,double> sums() {
+        std::pair<double,double> r(0.0, 0.0);
+        for(std::size_t k=0; k<SHARDS; ++k) {
+            std::lock_guard<std::mutex> lock(_shards[k].mutex);
+            r.first += _shards[k].sum_mean_dw;
+            r.second += _shards[k].sum_n;
+        }
+        return r;
+    }
+
+protected:
+    shard _shards[SHARDS];
+};
+
+} // parent_quality
+
+/*! Tracks parent quality (see above), and drives heritable mutation rates.
+
+ If PARENT_QUALITY_MUTATION_STEP (s) is set, each offspring inherits the mean
+ PARENT_QUALITY_MUTATION_SCALE of its parents, multiplied by s if its parents'
+ offspring have so far been no fitter than them (they are on or near a peak),
+ or divided by s if they have been fitter (they are on a slope), and clipped
+ to [1/16, 16].  heritable_mutation applies the scale.
+
+ Writes parent_quality.dat every RECORDING_PERIOD updates: the population
+ means of delta_w, of the number of evaluated offspring, and of the mutation
+ scale.  Add it to the EA through static_events (see static_events.h).
+ */
+template <typename EA>
+struct parent_quality_tracker {
+    parent_quality_tracker(EA& ea) : _df("parent_quality.dat") {
+        _df.add_field("update")
+        .add_field("mean_delta_w")
+        .add_field("mean_num_offspring")
+        .add_field("mean_mutation_scale");
+    }
+
+    void inheritance(typename EA::population_type& parents, typename EA::individual_type& offspring, EA& ea) {
+        parent_quality::record r;
+        r.pending = true;
+        r.born = ea.current_update();
+        double step=get<PARENT_QUALITY_MUTATION_STEP>(ea, 0.0);
+        double scale=0.0, dw=0.0;
+        unsigned n=0;
+        for(typename EA::population_type::iterator i=parents.begin(); i!=parents.end(); ++i) {
+            long name=static_cast<long>((*i)->name());
+            if(r.nparents < 2) {
+                r.parents[r.nparents] = name;
+            }
+            if(is_evaluated(**i) && (r.nparents < 2)) {
+                r.parent_w += real_fitness(**i);
+                ++r.nparents;
+            }
+            scale += get<PARENT_QUALITY_MUTATION_SCALE>(**i, 1.0);
+            parent_quality::table::shard& s=_table.at(name);
+            std::lock_guard<std::mutex> lock(s.mutex);
+            std::unordered_map<long, parent_quality::record>::iterator p=s.records.find(name);
+            if((p != s.records.end()) && p->second.n) {
+                dw += p->second.mean_dw();
+                ++n;
+            }
+        }
+        if(r.nparents) {
+            r.parent_w /= r.nparents;
+        }
+        if(step > 0.0) {
+            scale /= std::max(parents.size(), static_cast<std::size_t>(1));
+            if(n) {
+                typedef typename EA::fitness_function_type::direction_tag direction_tag;
+                scale = better(dw / n, 0.0, direction_tag()) ? (scale / step) : (scale * step);
+            }
+            r.scale = std::min(16.0, std::max(1.0/16.0, scale));
+            put<PARENT_QUALITY_MUTATION_SCALE>(r.scale, offspring);
+        }
+
+        long name=static_cast<long>(offspring.name());
+        parent_quality::table::shard& s=_table.at(name);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.records[name] = r;
+    }
+
+    void fitness_evaluated(typename EA::individual_type& ind, EA& ea) {
+        long name=static_cast<long>(ind.name());
+        parent_quality::record r;
+        {
+            parent_quality::table::shard& s=_table.at(name);
+            std::lock_guard<std::mutex> lock(s.mutex);
+            std::unordered_map<long, parent_quality::record>::iterator i=s.records.find(name);
+            if((i == s.records.end()) || !i->second.pending) {
+                return;
+            }
+            i->second.pending = false;
+            r = i->second;
+        }
+        if(r.nparents == 0) {
+            return;
+        }
+        double dw=real_fitness(ind) - r.parent_w;
+        for(unsigned char j=0; j<r.nparents; ++j) {
+            _table.credit(r.parents[j], dw);
+        }
+    }
+
+    void end_of_update(EA& ea) {
+        _alive.clear();
+        _scale.clear();
+        for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
+            _alive.insert(static_cast<long>(i->name()));
+            _scale.push_back(get<PARENT_QUALITY_MUTATION_SCALE>(*i, 1.0));
+        }
+        _table.collect(_alive, ea.current_update());
+    }
+
+    void record_statistics(EA& ea) {
+        std::pair<double,double> s=_table.sums();
+        double n=static_cast<double>(std::max(ea.population().size(), static_cast<std::size_t>(1)));
+        _df.write(ea.current_update())
+        .write(s.first / n)
+        .write(s.second / n)
+        .write(_scale.mean())
+        .endl();
+    }
+
+    parent_quality::table _table; //!< Records of living individuals.
+    std::unordered_set<long> _alive; //!< Names of the population; reused between updates.
+    statistics::sample _scale; //!< Mutation scales of the population.
+    datafile _df;
+};
+
+/*! Mutation operator that scales MUTATION_PER_SITE_P by the individual's
+ heritable PARENT_QUALITY_MUTATION_SCALE (see parent_quality_tracker), and
+ passes the scaled rate to the embedded operator, which must accept it (e.g.,
+ packed_per_site_bitflip).  The EA's metadata is only read, so offspring can
+ be mutated off the EA's thread.
+ */
+template <typename MutationOperator>
+struct heritable_mutation {
+    typedef MutationOperator embedded_type;
+
+    template <typename EA>
+    void operator()(typename EA::individual_type& ind, EA& ea) {
+        _mt(ind, std::min(1.0, get<MUTATION_PER_SITE_P>(ea) * get<PARENT_QUALITY_MUTATION_SCALE>(ind, 1.0)), ea);
+    }
+
+    embedded_type _mt; //!< Underlying mutation operator.
+};
+
+#endif
@@ -0,0 +1,414 @@
+/* qhfc.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _QHFC_H_
+#define _QHFC_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+
+#include <ea/metadata.h>
+#include <ea/datafile.h>
+
+#include "counter_rng.h"
+#include "delay.h"
+#include "evaluation.h"
+#include "order_statistics.h"
+#include "statistics.h"
+
+using namespace ealib;
+
+LIBEA_MD_DECL(QHFC_POP_SCALE, "ea.qhfc.population_scale", double);
+LIBEA_MD_DECL(QHFC_BREED_TOP_FREQ, "ea.qhfc.breed_top_freq", int);
+LIBEA_MD_DECL(QHFC_DETECT_EXPORT_NUM, "ea.qhfc.detect_export_num", int);
+LIBEA_MD_DECL(QHFC_PERCENT_REFILL, "ea.qhfc.percent_refill", double);
+LIBEA_MD_DECL(QHFC_CATCHUP_GEN, "ea.qhfc.catchup_gen", int);
+LIBEA_MD_DECL(QHFC_NO_PROGRESS_GEN, "ea.qhfc.no_progess_gen", int);
+LIBEA_MD_DECL(QHFC_LEVEL, "individual.qhfc.level", int);
+LIBEA_MD_DECL(QHFC_LAST_PROGRESS, "qhfc.state.last_progress", int);
+
+/*! Quick hierarchical fair competition (QHFC; Hu, Goodman et al., GECCO 2005).
+
+ The population is divided into METAPOPULATION_SIZE fitness levels; level l
+ holds at most POPULATION_SIZE * QHFC_POP_SCALE^l individuals (and at least 2),
+ and only admits individuals whose fitness is at least as good as its
+ admission threshold.  Every QHFC_CATCHUP_GEN updates, the thresholds are
+ spread evenly between the median fitness of the bottom level and the best
+ fitness of any level.  Level 0 admits any fitness.
+
+ Each update, each level of at least two members breeds as many offspring as
+ it can hold (the top level QHFC_BREED_TOP_FREQ times as many), from parents
+ drawn from itself.  Offspring from all levels are evaluated together, in
+ evaluation_pool(), after which each level (concurrently) keeps the fittest of
+ its members and offspring.  Then, from the top down, each level exports up to
+ QHFC_DETECT_EXPORT_NUM of its fittest members that meet the next level's
+ threshold; an export into a full level replaces its weakest member, if it is
+ fitter.  If the best fitness of the bottom level has not improved for
+ QHFC_NO_PROGRESS_GEN updates, its weakest QHFC_PERCENT_REFILL are replaced
+ by random individuals, each drawn from its own counter_rng stream.  Better is
+ always as defined by the fitness function's direction_tag.
+
+ Each level keeps its members ranked by fitness (weakest first) in an
+ indexed_skiplist (see order_statistics.h), which is updated as individuals
+ join and leave it rather than re-sorted.  Truncation removes the weakest in
+ O(1) each; thresholds are a select() on the bottom level, and the export
+ candidates of a level are counted with one rank() and taken from its top,
+ each in O(log P).
+
+ The EA's population is the union of all levels, and each individual records
+ its level in QHFC_LEVEL, so that the levels can be rebuilt from a
+ checkpoint.
+ */
+template <typename ParentSelectionStrategy>
+struct qhfc {
+    typedef ParentSelectionStrategy parent_selection_type;
+
+    //! Returns the capacity of level l.
+    template <typename EA>
+    static std::size_t capacity(std::size_t l, EA& ea) {
+        double n=get<POPULATION_SIZE>(ea) * std::pow(get<QHFC_POP_SCALE>(ea,1.0), static_cast<double>(l));
+        return std::max(static_cast<std::size_t>(2), static_cast<std::size_t>(n + 0.5));
+    }
+
+    //! Apply this generational model to the population.
+    template <typename Population, typename EA>
+    void operator()(Population& population, EA& ea) {
+        typedef typename EA::individual_ptr_type individual_ptr_type;
+        typedef typename EA::fitness_function_type::direction_tag direction_tag;
+
+        if(!_state) {
+            initialize(population, ea);
+        }
+        state<EA>& s=*std::static_pointer_cast<state<EA> >(_state);
+        std::vector<level<EA> >& levels=s.levels;
+        const std::size_t top=levels.size() - 1;
+
+        // breed each level from itself:
+        s.batch.clear();
+        for(std::size_t i=0; i<levels.size(); ++i) {
+            level<EA>& l=levels[i];
+            l.offspring.clear();
+            if(l.members.size() < 2) {
+                continue;
+            }
+            std::size_t n=capacity(i, ea) * ((i == top) ? std::max(get<QHFC_BREED_TOP_FREQ>(ea,1), 1) : 1);
+            recombine_n(l.members, l.offspring,
+                        parent_selection_type(n, l.members, ea),
+                        typename EA::recombination_operator_type(),
+                        n, ea);
+            mutate(l.offspring.begin(), l.offspring.end(), ea);
+            s.batch.insert(s.batch.end(), l.offspring.begin(), l.offspring.end());
+        }
+
+        // evaluate all offspring at once, then each level keeps its fittest, concurrently:
+        evaluate_batch(s.batch.begin(), s.batch.end(), evaluation_pool(ea), ea);
+        evaluation_pool(ea).parallel_for(levels.size(), [&](std::size_t i) {
+            level<EA>& l=levels[i];
+            rank(l.offspring.begin(), l.offspring.end(), l.ranking);
+            truncate(l.ranking, capacity(i, ea));
+        });
+
+        // export the fittest of each level that meet the next level's threshold, from the top down:
+        std::size_t k=std::max(get<QHFC_DETECT_EXPORT_NUM>(ea,1), 0);
+        for(std::size_t i=top; i>0; --i) {
+            ranking_type<EA>& from=levels[i-1].ranking;
+            std::size_t n=std::min(k, from.size() - from.rank(key_type(_thresholds[i], std::numeric_limits<long>::min())));
+            for(std::size_t j=0; j<n; ++j) {
+                std::pair<key_type,individual_ptr_type> e=from.select(from.size() - 1);
+                from.erase(e.first);
+                admit(levels[i].ranking, e.first, e.second, capacity(i, ea), direction_tag());
+            }
+        }
+
+        // restart the weakest of the bottom level if it has stopped improving:
+        ranking_type<EA>& bottom=levels[0].ranking;
+        if(!bottom.empty() && better(bottom.back().first.first, _best, direction_tag())) {
+            _best = bottom.back().first.first;
+            put<QHFC_LAST_PROGRESS>(static_cast<int>(ea.current_update()), ea);
+        }
+        int window=get<QHFC_NO_PROGRESS_GEN>(ea,0);
+        if((window > 0) && ((static_cast<int>(ea.current_update()) - get<QHFC_LAST_PROGRESS>(ea)) >= window)) {
+            std::size_t n=static_cast<std::size_t>(get<QHFC_PERCENT_REFILL>(ea,0.0) * capacity(0, ea));
+            for(std::size_t j=0; (j<n) && !bottom.empty(); ++j) {
+                bottom.pop_front();
+            }
+            s.batch.clear();
+            for(std::size_t j=0; j<n; ++j) {
+                individual_ptr_type p=ea.make_individual();
+                counter_rng rng=rng_stream(j, counter_rng::QHFC_REFILL, ea);
+                random_genome(p->genome(), rng, ea);
+                put<IND_GENERATION>(0.0, *p);
+                s.batch.push_back(p);
+            }
+            evaluate_batch(s.batch.begin(), s.batch.end(), evaluation_pool(ea), ea);
+            rank(s.batch.begin(), s.batch.end(), bottom);
+            _best = bottom.empty() ? worst(direction_tag()) : bottom.back().first.first;
+            put<QHFC_LAST_PROGRESS>(static_cast<int>(ea.current_update()), ea);
+        }
+
+        // raise the thresholds to catch up with the levels:
+        int period=get<QHFC_CATCHUP_GEN>(ea,1);
+        if((period > 0) && (ea.current_update() > 0) && ((ea.current_update() % period) == 0)) {
+            catchup(s, ea);
+        }
+
+        // the population is the union of the levels:
+        population.clear();
+        for(std::size_t i=0; i<levels.size(); ++i) {
+            level<EA>& l=levels[i];
+            l.members.clear();
+            l.ranking.for_each([&l](const key_type&, const individual_ptr_type& p) { l.members.push_back(p); });
+            for(typename Population::iterator j=l.members.begin(); j!=l.members.end(); ++j) {
+                put<QHFC_LEVEL>(static_cast<int>(i), **j);
+            }
+            population.insert(population.end(), l.members.begin(), l.members.end());
+        }
+    }
+
+protected:
+    //! Ranking key of an individual: its fitness, with ties broken by name.
+    typedef std::pair<double,long> key_type;
+
+    //! Orders ranking keys weakest first, in the fitness function's direction.
+    template <typename DirectionTag>
+    struct weakest_first {
+        bool operator()(const key_type& x, const key_type& y) const {
+            if(x.first != y.first) {
+                return better(y.first, x.first, DirectionTag());
+            }
+            return x.second < y.second;
+        }
+    };
+
+    //! Members of a level, weakest first.
+    template <typename EA>
+    struct ranking_type : indexed_skiplist<key_type, typename EA::individual_ptr_type,
+                                           weakest_first<typename EA::fitness_function_type::direction_tag> > {
+    };
+
+    //! A single fitness level.
+    template <typename EA>
+    struct level {
+        typename EA::population_type members; //!< Individuals in this level, weakest first.
+        ranking_type<EA> ranking; //!< Members, weakest first.
+        typename EA::population_type offspring; //!< Scratch: offspring bred this update.
+    };
+
+    //! All of the levels, plus scratch space for the individuals to be evaluated.
+    template <typename EA>
+    struct state {
+        std::vector<level<EA> > levels; //!< Fitness levels, lowest first.
+        typename EA::population_type batch; //!< Scratch: individuals to be evaluated.
+    };
+
+    //! Returns the ranking key of individual p.
+    template <typename IndividualPtr>
+    static key_type key(const IndividualPtr& p) {
+        return key_type(static_cast<double>(p->fitness()), static_cast<long>(p->name()));
+    }
+
+    //! Sets up the levels, either from scratch (all in level 0) or from a checkpointed population.
+    template <typename Population, typename EA>
+    void initialize(Population& population, EA& ea) {
+        std::shared_ptr<state<EA> > s(new state<EA>());
+        const std::size_t nlevels=std::max(get<METAPOPULATION_SIZE>(ea), 1);
+        s->levels.resize(nlevels);
+        for(std::size_t i=0; i<nlevels; ++i) {
+            level<EA>& l=s->levels[i];
+            std::size_t n=capacity(i, ea) * ((i+1 == nlevels) ? std::max(get<QHFC_BREED_TOP_FREQ>(ea,1), 1) : 1);
+            l.members.reserve(capacity(i, ea));
+            l.offspring.reserve(n);
+            s->batch.reserve(s->batch.capacity() + n);
+        }
+        evaluate_pending(population.begin(), population.end(), ea);
+        for(typename Population::iterator i=population.begin(); i!=population.end(); ++i) {
+            std::size_t l=std::min(static_cast<std::size_t>(get<QHFC_LEVEL>(**i,0)), nlevels-1);
+            s->levels[l].ranking.insert(key(*i), *i);
+        }
+        for(std::size_t i=0; i<nlevels; ++i) {
+            truncate(s->levels[i].ranking, capacity(i, ea));
+            s->levels[i].ranking.for_each([&](const key_type&, const typename EA::individual_ptr_type& p) {
+                s->levels[i].members.push_back(p);
+            });
+        }
+        typedef typename EA::fitness_function_type::direction_tag direction_tag;
+        _best = s->levels[0].ranking.empty() ? worst(direction_tag()) : s->levels[0].ranking.back().first.first;
+        if(!exists<QHFC_LAST_PROGRESS>(ea)) {
+            put<QHFC_LAST_PROGRESS>(static_cast<int>(ea.current_update()), ea);
+        }
+        catchup(*s, ea);
+        _state = s;
+    }
+
+    /*! Spreads the admission thresholds evenly between the median fitness of
+     level 0 and the best fitness of any level.
+     */
+    template <typename EA>
+    void catchup(state<EA>& s, EA& ea) {
+        typedef typename EA::fitness_function_type::direction_tag direction_tag;
+        std::vector<level<EA> >& levels=s.levels;
+        _thresholds.assign(levels.size(), worst(direction_tag()));
+        ranking_type<EA>& bottom=levels[0].ranking;
+        if(bottom.empty()) {
+            return;
+        }
+        double lo=bottom.select(bottom.size() / 2).first.first;
+        double hi=lo;
+        for(std::size_t i=0; i<levels.size(); ++i) {
+            if(!levels[i].ranking.empty() && better(levels[i].ranking.back().first.first, hi, direction_tag())) {
+                hi = levels[i].ranking.back().first.first;
+            }
+        }
+        for(std::size_t i=1; i<levels.size(); ++i) {
+            _thresholds[i] = lo + (hi - lo) * static_cast<double>(i) / static_cast<double>(levels.size());
+        }
+    }
+
+    //! Adds the (evaluated) individuals in [f, l) to ranking r.
+    template <typename ForwardIterator, typename Ranking>
+    static void rank(ForwardIterator f, ForwardIterator l, Ranking& r) {
+        for( ; f!=l; ++f) {
+            r.insert(key(*f), *f);
+        }
+    }
+
+    //! Adds (k, p) to ranking r, unless r already holds n members and p is no fitter than the weakest.
+    template <typename Ranking, typename IndividualPtr, typename DirectionTag>
+    static void admit(Ranking& r, const key_type& k, const IndividualPtr& p, std::size_t n, DirectionTag) {
+        if(!r.empty() && (r.size() >= n) && !weakest_first<DirectionTag>()(r.front().first, k)) {
+            return;
+        }
+        r.insert(k, p);
+        truncate(r, n);
+    }
+
+    //! Keeps the n fittest members of ranking r.
+    template <typename Ranking>
+    static void truncate(Ranking& r, std::size_t n) {
+        while(r.size() > n) {
+            r.pop_front();
+        }
+    }
+
+    std::shared_ptr<void> _state; //!< Fitness levels.
+    std::vector<double> _thresholds; //!< Admission threshold of each level.
+    double _best; //!< Best fitness of level 0 when it last improved.
+};
+
+/*! Datafile for the size and the best and worst fitness of each QHFC level.
+ */
+template <typename EA>
+struct qhfc_datafile {
+    qhfc_datafile(EA& ea) : _df("qhfc.dat") {
+        _df.add_field("update");
+        for(int i=0; i<get<METAPOPULATION_SIZE>(ea); ++i) {
+            std::string l=boost::lexical_cast<std::string>(i);
+            _df.add_field("level" + l + "_size")
+            .add_field("level" + l + "_best_w")
+            .add_field("level" + l + "_worst_w");
+        }
+    }
+
+    void record_statistics(EA& ea) {
+        typedef typename EA::fitness_function_type::direction_tag direction_tag;
+        std::size_t n=get<METAPOPULATION_SIZE>(ea);
+        _size.assign(n, 0);
+        _best.resize(n);
+        _worst.resize(n);
+        for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
+            std::size_t l=std::min(static_cast<std::size_t>(get<QHFC_LEVEL>(*i,0)), n-1);
+            double w=static_cast<double>(i->fitness());
+            if((_size[l]++ == 0) || better(w, _best[l], direction_tag())) {
+                _best[l] = w;
+            }
+            if((_size[l] == 1) || better(_worst[l], w, direction_tag())) {
+                _worst[l] = w;
+            }
+        }
+
+        _df.write(ea.current_update());
+        for(std::size_t i=0; i<n; ++i) {
+            _df.write(_size[i])
+            .write(_size[i] ? _best[i] : 0.0)
+            .write(_size[i] ? _worst[i] : 0.0);
+        }
+        _df.endl();
+    }
+
+    std::vector<std::size_t> _size; //!< Members of each level.
+    std::vector<double> _best; //!< Best fitness in each level.
+    std::vector<double> _worst; //!< Worst fitness in each level.
+    datafile _df;
+};
+
+/*! Publishes QHFC gauges: the size and max fitness of each level, and RSS
+ (sampled every METRICS_RSS_PERIOD updates).
+
+ Disabled unless METRICS_SHM is set.
+ */
+template <typename EA>
+struct qhfc_metrics {
+    qhfc_metrics(EA& ea) : _rss(get<METRICS_RSS_PERIOD>(ea,64)) {
+        std::string name=get<METRICS_SHM>(ea, std::string());
+        if(name.empty()) {
+            return;
+        }
+        std::vector<std::string> fields;
+        fields.push_back("update");
+        fields.push_back("rss_bytes");
+        std::size_t n=std::min(static_cast<std::size_t>(get<METAPOPULATION_SIZE>(ea)),
+                               static_cast<std::size_t>((metrics::MAX_FIELDS - 2) / 2));
+        for(std::size_t i=0; i<n; ++i) {
+            std::string l=boost::lexical_cast<std::string>(i);
+            fields.push_back("level" + l + "_size");
+            fields.push_back("level" + l + "_max_w");
+        }
+        _values.resize(fields.size());
+        _writer.reset(new metrics::writer(name, fields, get<METRICS_KEEP>(ea,0)));
+    }
+
+    void end_of_update(EA& ea) {
+        if(!_writer) {
+            return;
+        }
+        std::fill(_values.begin(), _values.end(), 0.0);
+        _values[0] = ea.current_update();
+        _values[1] = _rss();
+        for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
+            std::size_t k=2 + 2*static_cast<std::size_t>(get<QHFC_LEVEL>(*i,0));
+            if((k+1) < _values.size()) {
+                _values[k] += 1.0;
+                _values[k+1] = std::max(_values[k+1], static_cast<double>(i->fitness()));
+            }
+        }
+        _writer->write(&_values[0]);
+    }
+
+    std::shared_ptr<metrics::writer> _writer; //!< Shared-memory writer.
+    std::vector<double> _values; //!< Record being written.
+    metrics::rss_sampler _rss; //!< Resident set size.
+};
+
+#endif
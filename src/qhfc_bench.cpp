@@ -17,32 +17,35 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
-#include <ea/qhfc.h>
+#include <ea/evolutionary_algorithm.h>
 #include <ea/genome_types/realstring.h>
-#include <ea/fitness_functions/all_ones.h>
+#include <ea/fitness_functions/benchmarks.h>
+#include <ea/selection/tournament.h>
 #include <ea/cmdline_interface.h>
 #include <ea/mutation.h>
 #include <ea/recombination.h>
-
 #include <ea/datafiles/evaluations.h>
 #include <ea/datafiles/fitness.h>
-#include <ea/datafiles/population_entropy.h>
-#include <ea/genome_types/realstring.h>
-#include <ea/cmdline_interface.h>
-#include <ea/algorithm.h>
-#include <ea/metapopulation.h>
-#include <ea/fitness_functions/benchmarks.h>
-#include <ea/qhfc.h>
 using namespace ealib;
 
-typedef qhfc
+#include "qhfc.h"
+#include "stopping.h"
+#include "run_log.h"
+#include "static_events.h"
+
+typedef evolutionary_algorithm
 < direct<realstring>
 , benchmarks
 , mutation::operators::per_site<mutation::site::uniform_real>
 , recombination::two_point_crossover
+, qhfc<selection::tournament< > >
 , ancestors::uniform_real
+, convergence_stop
 > ea_type;
 
+//! Events dispatched without virtual calls (see static_events.h), in order.
+typedef static_events<qhfc_datafile, qhfc_metrics, stop_monitor, run_recorder> qhfc_events;
+
 
 /*! Define the EA's command-line interface.
  */
@@ -56,7 +59,10 @@ public:
         add_option<MUTATION_PER_SITE_P>(this);
         add_option<MUTATION_UNIFORM_REAL_MIN>(this);
         add_option<MUTATION_UNIFORM_REAL_MAX>(this);
-        add_option<ELITISM_N>(this);
+        add_option<TOURNAMENT_SELECTION_N>(this);
+        add_option<TOURNAMENT_SELECTION_K>(this);
+        add_option<ASYNC_THREADS>(this);
+        add_option<QHFC_POP_SCALE>(this);
         add_option<QHFC_BREED_TOP_FREQ>(this);
         add_option<QHFC_DETECT_EXPORT_NUM>(this);
         add_option<QHFC_PERCENT_REFILL>(this);
@@ -68,16 +74,20 @@ public:
         add_option<CHECKPOINT_PREFIX>(this);
         add_option<RNG_SEED>(this);
         add_option<RECORDING_PERIOD>(this);
+        add_option<STOP_TARGET_W>(this);
+        add_option<STOP_STAGNATION_WINDOW>(this);
+        add_option<STOP_EVALUATION_BUDGET>(this);
+        add_option<RUN_LOG>(this);
+        add_option<METRICS_SHM>(this);
+        add_option<METRICS_KEEP>(this);
+        add_option<METRICS_RSS_PERIOD>(this);
         add_option<BENCHMARKS_FUNCTION>(this);
     }
     
     virtual void gather_events(EA& ea) {
-        add_event<datafiles::qhfc_dat>(ea);
-
-//        add_event<datafiles::meta_population_entropy>(this, ea);
-//        add_event<datafiles::meta_population_fitness>(this, ea);
-//        add_event<datafiles::meta_population_fitness_evaluations>(this, ea);
-
+        add_event<datafiles::fitness_dat>(ea);
+        add_event<datafiles::fitness_evaluations>(ea);
+        add_event<qhfc_events::type>(ea);
     };
 };
 LIBEA_CMDLINE_INSTANCE(ea_type, cli);
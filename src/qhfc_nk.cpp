@@ -1,19 +1,43 @@
-#include <ea/qhfc.h>
+#include <ea/evolutionary_algorithm.h>
 #include <ea/genome_types/bitstring.h>
 #include <ea/fitness_functions/nk_model.h>
+#include <ea/selection/tournament.h>
 #include <ea/datafiles/evaluations.h>
-#include <ea/datafiles/metapopulation_fitness.h>
+#include <ea/datafiles/fitness.h>
 #include <ea/cmdline_interface.h>
 using namespace ealib;
 
-typedef qhfc
-< direct<bitstring>
-, nk_model< >
-, mutation::operators::per_site<mutation::site::bitflip>
-, recombination::two_point_crossover
+#include "qhfc.h"
+#include "stopping.h"
+#include "run_log.h"
+#include "packed_bitstring.h"
+#include "hashed_nk_model.h"
+#include "static_events.h"
+
+// build with HIMALAYA_HASHED_NK defined to use the table-free NK landscape, and
+// also HIMALAYA_FIXED_SHAPE to specialize that landscape for N=32, K=8; libea's
+// table nk_model, the default, is not specialized:
+#if defined(HIMALAYA_HASHED_NK) && defined(HIMALAYA_FIXED_SHAPE)
+typedef fixed_nk_model<32,8> nk_type;
+#elif defined(HIMALAYA_HASHED_NK)
+typedef hashed_nk_model nk_type;
+#else
+typedef nk_model< > nk_type;
+#endif
+
+typedef evolutionary_algorithm
+< direct<packed_bitstring>
+, nk_type
+, packed_per_site_bitflip
+, packed_two_point_crossover
+, qhfc<selection::tournament< > >
 , ancestors::random_bitstring
+, convergence_stop
 > ea_type;
 
+//! Events dispatched without virtual calls (see static_events.h), in order.
+typedef static_events<qhfc_datafile, qhfc_metrics, stop_monitor, run_recorder> qhfc_events;
+
 
 /*! Define the EA's command-line interface.
  */
@@ -37,9 +61,18 @@ public:
         add_option<CHECKPOINT_PREFIX>(this);
         add_option<RNG_SEED>(this);
         add_option<RECORDING_PERIOD>(this);
+        add_option<STOP_TARGET_W>(this);
+        add_option<STOP_STAGNATION_WINDOW>(this);
+        add_option<STOP_EVALUATION_BUDGET>(this);
+        add_option<RUN_LOG>(this);
+        add_option<METRICS_SHM>(this);
+        add_option<METRICS_KEEP>(this);
+        add_option<METRICS_RSS_PERIOD>(this);
         add_option<ANALYSIS_OUTPUT>(this);
         
-        add_option<ELITISM_N>(this);
+        add_option<TOURNAMENT_SELECTION_N>(this);
+        add_option<TOURNAMENT_SELECTION_K>(this);
+        add_option<ASYNC_THREADS>(this);
         add_option<QHFC_POP_SCALE>(this);
         add_option<QHFC_BREED_TOP_FREQ>(this);
         add_option<QHFC_DETECT_EXPORT_NUM>(this);
@@ -56,9 +89,9 @@ public:
     }
     
     virtual void gather_events(EA& ea) {
-        add_event<datafiles::qhfc_dat>(ea);
-//        add_event<datafiles::meta_population_fitness>(ea);
-//        add_event<datafiles::meta_population_fitness_evaluations>(ea);
+        add_event<datafiles::fitness_dat>(ea);
+        add_event<datafiles::fitness_evaluations>(ea);
+        add_event<qhfc_events::type>(ea);
     };
 };
 LIBEA_CMDLINE_INSTANCE(ea_type, cli);
@@ -0,0 +1,273 @@
+/* replay.cpp
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "run_log.h"
+#include "thread_pool.h"
+
+/*! Replays run logs (see run_log.h), and writes an analysis of each.
+
+ Usage: himalaya-replay <analysis> [-j threads] [-u update] <run_log.bin>...
+
+ Analyses:
+
+ summary: <log>.summary.dat, one row per update: population size, births,
+ deaths, the number of evaluated individuals, and the mean and best w (and
+ w_real, and w_eff where known) among them.
+
+ population: <log>.population.dat, the population at the end of update -u
+ (by default, the last update): name, update of birth, first parent,
+ fitnesses, and genome.
+
+ lineage: <log>.lineage.dat, the line of descent (through first parents) of
+ the best individual at the end of update -u, from it back to its founder:
+ name, update of birth, the number of loci that differ from its closest
+ parent, and fitnesses.
+
+ Each analysis is a replay handler (see run_log.h), constructed from its
+ output file and the options, and fed by replay::next(); the log is replayed
+ up to update -u, after which the handler's end_of_replay is called.  To add
+ an analysis, write a handler and list it in analyses below.  Logs are
+ replayed in parallel, one per thread; nothing is evaluated.
+ */
+
+//! Analysis options.
+struct options {
+    options() : update(std::numeric_limits<boost::uint64_t>::max()) { }
+    std::string analysis; //!< Name of the analysis.
+    boost::uint64_t update; //!< Last update to replay.
+};
+
+//! Returns the best evaluated member of the population (ties to the oldest), or false if there is none.
+template <typename Replay>
+bool best(const Replay& r, typename Replay::name_type& name) {
+    bool found=false;
+    for(typename std::set<typename Replay::name_type>::const_iterator i=r.population().begin(); i!=r.population().end(); ++i) {
+        const typename Replay::individual& ind=r[*i];
+        if(ind.evaluated && (!found || r.better(ind.w, r[name].w))) {
+            name = *i;
+            found = true;
+        }
+    }
+    return found;
+}
+
+//! Appends the values of g to out.
+template <typename Genome>
+void print_genome(const Genome& g, FILE* out) {
+    for(std::size_t i=0; i<g.size(); ++i) {
+        std::fprintf(out, "%s%.10g", (i ? "," : ""), static_cast<double>(g[i]));
+    }
+}
+
+void print_genome(const packed_bitstring& g, FILE* out) {
+    for(std::size_t i=0; i<g.size(); ++i) {
+        std::fputc('0' + g[i], out);
+    }
+}
+
+//! Writes one row of summary per update.
+template <typename Replay>
+struct summary_analysis : run_log::replay_handler {
+    summary_analysis(FILE* out, const options& opt) : _out(out) {
+        std::fprintf(_out, "update population births deaths evaluated mean_w best_w mean_w_real best_w_real mean_w_eff\n");
+    }
+
+    void end_of_update(const Replay& r) {
+        std::size_t n=0, nr=0, ne=0;
+        double w=0.0, w_real=0.0, w_eff=0.0, best_w=0.0, best_real=0.0;
+        for(typename std::set<typename Replay::name_type>::const_iterator i=r.population().begin(); i!=r.population().end(); ++i) {
+            const typename Replay::individual& ind=r[*i];
+            if(!ind.evaluated) {
+                continue;
+            }
+            best_w = (n && !r.better(ind.w, best_w)) ? best_w : ind.w;
+            w += ind.w;
+            ++n;
+            if(!std::isnan(ind.w_real)) {
+                best_real = (nr && !r.better(ind.w_real, best_real)) ? best_real : ind.w_real;
+                w_real += ind.w_real;
+                ++nr;
+            }
+            if(!std::isnan(ind.w_eff)) {
+                w_eff += ind.w_eff;
+                ++ne;
+            }
+        }
+        std::fprintf(_out, "%llu %zu %zu %zu %zu %.10g %.10g %.10g %.10g %.10g\n",
+                     static_cast<unsigned long long>(r.update()), r.population().size(), r.births(), r.deaths(), n,
+                     n ? (w / n) : 0.0, best_w, nr ? (w_real / nr) : 0.0, best_real, ne ? (w_eff / ne) : 0.0);
+    }
+
+    FILE* _out;
+};
+
+//! Writes the population at the end of the replay.
+template <typename Replay>
+struct population_analysis : run_log::replay_handler {
+    population_analysis(FILE* out, const options& opt) : _out(out) {
+        std::fprintf(_out, "update name born parent w w_real w_eff genome\n");
+    }
+
+    void end_of_replay(const Replay& r) {
+        for(typename std::set<typename Replay::name_type>::const_iterator i=r.population().begin(); i!=r.population().end(); ++i) {
+            const typename Replay::individual& ind=r[*i];
+            std::fprintf(_out, "%llu %llu %llu %lld %.10g %.10g %.10g ",
+                         static_cast<unsigned long long>(r.update()), static_cast<unsigned long long>(*i),
+                         static_cast<unsigned long long>(ind.born),
+                         ind.parents.empty() ? -1LL : static_cast<long long>(ind.parents.front()),
+                         ind.w, ind.w_real, ind.w_eff);
+            print_genome(r.genome(*i), _out);
+            std::fputc('\n', _out);
+        }
+    }
+
+    FILE* _out;
+};
+
+//! Writes the line of descent of the best individual at the end of the replay.
+template <typename Replay>
+struct lineage_analysis : run_log::replay_handler {
+    lineage_analysis(FILE* out, const options& opt) : _out(out) {
+        std::fprintf(_out, "depth name born changes w w_real w_eff\n");
+    }
+
+    void end_of_replay(const Replay& r) {
+        typename Replay::name_type name=0;
+        if(!best(r, name)) {
+            return;
+        }
+        std::vector<typename Replay::name_type> l=r.lineage(name);
+        for(std::size_t i=0; i<l.size(); ++i) {
+            const typename Replay::individual& ind=r[l[i]];
+            std::fprintf(_out, "%zu %llu %llu %u %.10g %.10g %.10g\n", i,
+                         static_cast<unsigned long long>(l[i]), static_cast<unsigned long long>(ind.born),
+                         static_cast<unsigned>(ind.changes), ind.w, ind.w_real, ind.w_eff);
+        }
+    }
+
+    FILE* _out;
+};
+
+//! Replays one log through Analysis; returns an error message, or the empty string.
+template <typename Genome, template <typename> class Analysis>
+std::string replay_log(const std::string& path, const options& opt) {
+    typedef run_log::replay<Genome> replay_type;
+    std::string outpath=path + "." + opt.analysis + ".dat";
+    FILE* out=std::fopen(outpath.c_str(), "w");
+    if(out == 0) {
+        return "could not write " + outpath;
+    }
+    try {
+        replay_type r(path);
+        Analysis<replay_type> a(out, opt);
+        bool any=false;
+        while((!any || (r.update() < opt.update)) && r.next(a)) {
+            any = true;
+        }
+        a.end_of_replay(r);
+    } catch(std::exception& e) {
+        std::fclose(out);
+        return e.what();
+    }
+    std::fclose(out);
+    return std::string();
+}
+
+//! Replays one log through Analysis, with the genome type it was written for.
+template <template <typename> class Analysis>
+std::string analyze(const std::string& path, const options& opt) {
+    std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+    run_log::header h;
+    if(!in.is_open() || !run_log::read_header(in, h)) {
+        return "not a run log";
+    }
+    if(h.codec == run_log::PACKED_BITS) {
+        return replay_log<packed_bitstring, Analysis>(path, opt);
+    } else if(h.value_size == sizeof(double)) {
+        return replay_log<std::vector<double>, Analysis>(path, opt);
+    } else if(h.value_size == sizeof(int)) {
+        return replay_log<std::vector<int>, Analysis>(path, opt);
+    }
+    return "unsupported genome type";
+}
+
+//! The analyses, by name.
+typedef std::string (*analysis_type)(const std::string&, const options&);
+const std::pair<const char*, analysis_type> analyses[] = {
+    std::make_pair("summary", &analyze<summary_analysis>),
+    std::make_pair("population", &analyze<population_analysis>),
+    std::make_pair("lineage", &analyze<lineage_analysis>)
+};
+
+int main(int argc, char* argv[]) {
+    options opt;
+    std::size_t threads=0;
+    std::vector<std::string> logs;
+    for(int i=1; i<argc; ++i) {
+        std::string a=argv[i];
+        if((a == "-j") && ((i+1) < argc)) {
+            threads = std::max(1, std::atoi(argv[++i])) - 1;
+        } else if((a == "-u") && ((i+1) < argc)) {
+            opt.update = std::strtoull(argv[++i], 0, 10);
+        } else if(opt.analysis.empty()) {
+            opt.analysis = a;
+        } else {
+            logs.push_back(a);
+        }
+    }
+    analysis_type analysis=0;
+    std::string names;
+    for(std::size_t i=0; i<(sizeof(analyses) / sizeof(analyses[0])); ++i) {
+        names += std::string(i ? "|" : "") + analyses[i].first;
+        if(opt.analysis == analyses[i].first) {
+            analysis = analyses[i].second;
+        }
+    }
+    if(logs.empty() || (analysis == 0)) {
+        std::fprintf(stderr, "usage: %s <%s> [-j threads] [-u update] <run_log.bin>...\n", argv[0], names.c_str());
+        return 1;
+    }
+
+    std::vector<std::string> errors(logs.size());
+    thread_pool pool(threads);
+    pool.parallel_for(logs.size(), [&](std::size_t i) {
+        errors[i] = analysis(logs[i], opt);
+    });
+
+    int status=0;
+    for(std::size_t i=0; i<logs.size(); ++i) {
+        if(errors[i].empty()) {
+            std::printf("%s.%s.dat\n", logs[i].c_str(), opt.analysis.c_str());
+        } else {
+            std::fprintf(stderr, "%s: %s: %s\n", argv[0], logs[i].c_str(), errors[i].c_str());
+            status = 1;
+        }
+    }
+    return status;
+}
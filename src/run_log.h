@@ -0,0 +1,716 @@
+/* run_log.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _RUN_LOG_H_
+#define _RUN_LOG_H_
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+#include <ea/metadata.h>
+
+#include "delay.h"
+#include "packed_bitstring.h"
+
+using namespace ealib;
+
+//! If set, every birth, evaluation and death is recorded in run_log.bin.
+LIBEA_MD_DECL(RUN_LOG, "run_log.enabled", int);
+
+/* Run log: an event-sourced history of a run.
+
+ Instead of keeping the whole line of descent, or checkpoints, in order to
+ compute new statistics after the fact, a run can record what happened to
+ its population: which individuals were born, from which parents and with
+ which genome; what their fitness was; and when they died.  A replay of the
+ log (see run_log::replay, and himalaya-replay) then rebuilds the population,
+ genomes included, at every update, and the line of descent of any
+ individual, without evaluating anything.
+
+ Offspring genomes are stored as the loci at which they differ from the
+ closest of their parents, so mutations and crossover segments are both
+ recovered exactly, whichever operators made them; founders and immigrants
+ are stored in full.  Parent selection is recorded by the parents of each
+ birth, and survivor selection by the deaths.
+
+ The file format is:
+
+ header: char[4] "HRL1", uint32 codec (see below), uint32
+ sizeof(Genome::value_type), uint32 direction (0=maximize, 1=minimize)
+
+ records: uint8 kind, followed by
+
+ FOUNDER: uint64 name, uint64 update, genome
+ BIRTH: uint64 name, uint64 update, uint8 n, n x uint64 parent, uint8 base,
+   uint32 count, and either count (uint32 locus, value) pairs relative to
+   parent[base], or, if count is FULL, the genome
+ EVALUATION: uint64 name, double w, double w_real, double w_eff (NaN if unknown)
+ DEATH: uint64 name
+ UPDATE: uint64 update, uint64 population size
+
+ Genomes are a uint32 size followed by size values (RAW), or by the packed
+ 64-bit words of a packed_bitstring (PACKED_BITS).  Each update's records end
+ with an UPDATE record; births and founders precede evaluations, which
+ precede deaths.  All fields are in host byte order.
+ */
+namespace run_log {
+
+enum { FOUNDER=1, BIRTH=2, EVALUATION=3, DEATH=4, UPDATE=5 }; //!< Record kinds.
+enum { RAW=0, PACKED_BITS=1 }; //!< Genome encodings.
+const boost::uint32_t FULL=0xffffffff; //!< Count of a birth that is stored in full.
+
+template <typename T>
+void write_pod(std::ostream& out, const T& t) {
+    out.write(reinterpret_cast<const char*>(&t), sizeof(T));
+}
+
+//! Reads t; returns false at the end of the stream.
+template <typename T>
+bool read_pod(std::istream& in, T& t) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&t), sizeof(T)));
+}
+
+//! Returns the encoding of a genome type.
+template <typename Genome>
+boost::uint32_t codec(const Genome& g) {
+    return RAW;
+}
+
+//! Returns the number of bytes g takes when written by write_genome.
+template <typename Genome>
+std::size_t genome_size(const Genome& g) {
+    return sizeof(boost::uint32_t) + g.size() * sizeof(typename Genome::value_type);
+}
+
+template <typename Genome>
+void write_genome(std::ostream& out, const Genome& g) {
+    write_pod(out, static_cast<boost::uint32_t>(g.size()));
+    for(std::size_t i=0; i<g.size(); ++i) {
+        write_pod(out, static_cast<typename Genome::value_type>(g[i]));
+    }
+}
+
+template <typename Genome>
+bool read_genome(std::istream& in, Genome& g) {
+    boost::uint32_t n=0;
+    if(!read_pod(in, n)) {
+        return false;
+    }
+    g.resize(n);
+    typename Genome::value_type v;
+    for(std::size_t i=0; i<n; ++i) {
+        if(!read_pod(in, v)) {
+            return false;
+        }
+        g[i] = v;
+    }
+    return true;
+}
+
+//! Sets loci to the positions at which a and b (of the same size) differ.
+template <typename Genome>
+void changed_loci(const Genome& a, const Genome& b, std::vector<boost::uint32_t>& loci) {
+    loci.clear();
+    for(std::size_t i=0; i<a.size(); ++i) {
+        if(a[i] != b[i]) {
+            loci.push_back(static_cast<boost::uint32_t>(i));
+        }
+    }
+}
+
+inline boost::uint32_t codec(const packed_bitstring& g) {
+    return PACKED_BITS;
+}
+
+inline std::size_t genome_size(const packed_bitstring& g) {
+    return sizeof(boost::uint32_t) + packed_bitstring::nwords(g.size()) * sizeof(packed_bitstring::word_type);
+}
+
+inline void write_genome(std::ostream& out, const packed_bitstring& g) {
+    write_pod(out, static_cast<boost::uint32_t>(g.size()));
+    const packed_bitstring::word_vector& w=g.words();
+    if(!w.empty()) {
+        out.write(reinterpret_cast<const char*>(&w[0]), w.size() * sizeof(packed_bitstring::word_type));
+    }
+}
+
+inline bool read_genome(std::istream& in, packed_bitstring& g) {
+    boost::uint32_t n=0;
+    if(!read_pod(in, n)) {
+        return false;
+    }
+    g.resize(n);
+    packed_bitstring::word_vector& w=g.words();
+    return w.empty() || in.read(reinterpret_cast<char*>(&w[0]), w.size() * sizeof(packed_bitstring::word_type));
+}
+
+//! Finds the differing bits a word at a time.
+inline void changed_loci(const packed_bitstring& a, const packed_bitstring& b, std::vector<boost::uint32_t>& loci) {
+    loci.clear();
+    const packed_bitstring::word_vector& x=a.words();
+    const packed_bitstring::word_vector& y=b.words();
+    for(std::size_t i=0; i<x.size(); ++i) {
+        for(packed_bitstring::word_type d=x[i]^y[i]; d!=0; d&=d-1) {
+            loci.push_back(static_cast<boost::uint32_t>(i * packed_bitstring::word_bits + __builtin_ctzll(d)));
+        }
+    }
+}
+
+//! Log header.
+struct header {
+    header() : codec(RAW), value_size(0), minimize(0) { }
+    boost::uint32_t codec; //!< Genome encoding.
+    boost::uint32_t value_size; //!< sizeof(Genome::value_type).
+    boost::uint32_t minimize; //!< 1 if lower fitness is better.
+};
+
+//! Reads the header of a run log; returns false if in is not one.
+inline bool read_header(std::istream& in, header& h) {
+    char magic[4];
+    return in.read(magic, 4)
+    && (std::string(magic, 4) == "HRL1")
+    && read_pod(in, h.codec)
+    && read_pod(in, h.value_size)
+    && read_pod(in, h.minimize);
+}
+
+/* Replay handlers.
+
+ An analysis of a run log is a handler: a class template over the replay
+ type, derived from replay_handler, with any of the following member
+ functions, which next(h) calls as it replays each record:
+
+    void birth(const Replay& r, typename Replay::name_type name);
+    void evaluation(const Replay& r, typename Replay::name_type name);
+    void death(const Replay& r, typename Replay::name_type name);
+    void end_of_update(const Replay& r);
+
+ and end_of_replay(r), which whoever drives the replay calls once it stops
+ (see himalaya-replay).  replay_events<H1, H2, ...>::type is a handler that
+ holds all of the given ones and calls them in list order, so that several
+ analyses share a single pass over the log, as static_events does for
+ an EA's events.
+ */
+
+//! Base for replay handlers; hooks that a handler does not define do nothing.
+struct replay_handler {
+    template <typename Replay> void birth(const Replay&, typename Replay::name_type) { }
+    template <typename Replay> void evaluation(const Replay&, typename Replay::name_type) { }
+    template <typename Replay> void death(const Replay&, typename Replay::name_type) { }
+    template <typename Replay> void end_of_update(const Replay&) { }
+    template <typename Replay> void end_of_replay(const Replay&) { }
+};
+
+/*! A compile-time list of replay handlers; see above.
+ */
+template <template <typename> class... Handlers>
+struct replay_events {
+
+    //! The handler that holds and dispatches to the handlers; handlers are its bases, constructed in list order from the same arguments.
+    template <typename Replay>
+    struct type : Handlers<Replay>... {
+        typedef typename Replay::name_type name_type;
+
+        template <typename... Args>
+        type(Args&&... args) : Handlers<Replay>(args...)... {
+        }
+
+        void birth(const Replay& r, name_type name) {
+            int expand[] = {0, (static_cast<Handlers<Replay>&>(*this).birth(r, name), 0)...};
+            (void)expand;
+        }
+
+        void evaluation(const Replay& r, name_type name) {
+            int expand[] = {0, (static_cast<Handlers<Replay>&>(*this).evaluation(r, name), 0)...};
+            (void)expand;
+        }
+
+        void death(const Replay& r, name_type name) {
+            int expand[] = {0, (static_cast<Handlers<Replay>&>(*this).death(r, name), 0)...};
+            (void)expand;
+        }
+
+        void end_of_update(const Replay& r) {
+            int expand[] = {0, (static_cast<Handlers<Replay>&>(*this).end_of_update(r), 0)...};
+            (void)expand;
+        }
+
+        void end_of_replay(const Replay& r) {
+            int expand[] = {0, (static_cast<Handlers<Replay>&>(*this).end_of_replay(r), 0)...};
+            (void)expand;
+        }
+
+        //! Returns handler H.
+        template <template <typename> class H>
+        H<Replay>& handler() {
+            return static_cast<H<Replay>&>(*this);
+        }
+    };
+};
+
+/*! Replays a run log, one update at a time.
+
+ After each call to next(), the population, and the genome and fitness of
+ each of its members, are as they were at the end of that update.  Every
+ individual that has ever lived is remembered (without its genome), so that
+ lines of descent can be followed back to a founder; genomes are kept only
+ while their owners are alive, and for one update after they die.
+ */
+template <typename Genome>
+class replay {
+public:
+    typedef Genome genome_type;
+    typedef typename Genome::value_type value_type;
+    typedef boost::uint64_t name_type;
+
+    static const boost::uint64_t ALIVE=0xffffffffffffffffULL; //!< Update of death of the living.
+
+    //! What is known about an individual.
+    struct individual {
+        individual() : born(0), died(ALIVE), changes(0), evaluated(false), w(0.0), w_real(0.0), w_eff(0.0) { }
+        std::vector<name_type> parents; //!< Parents, first parent first; empty for founders.
+        boost::uint64_t born; //!< Update of birth.
+        boost::uint64_t died; //!< Update of death, or ALIVE.
+        boost::uint32_t changes; //!< Loci that differ from the closest parent (the whole genome for founders).
+        bool evaluated; //!< True once its fitness is known.
+        double w; //!< Fitness.
+        double w_real; //!< Real fitness (NaN if unknown).
+        double w_eff; //!< Effective fitness (NaN if unknown).
+    };
+
+    //! Opens a run log.
+    replay(const std::string& filename) : _update(0), _births(0), _deaths(0) {
+        _f.rdbuf()->pubsetbuf(_buf, sizeof(_buf));
+        _f.open(filename.c_str(), std::ios::in | std::ios::binary);
+        if(!_f.is_open() || !read_header(_f, _header)) {
+            throw std::runtime_error("run_log: could not read " + filename);
+        }
+        if((_header.codec != codec(Genome())) || (_header.value_size != sizeof(value_type))) {
+            throw std::runtime_error("run_log: " + filename + " was written for a different genome type");
+        }
+    }
+
+    //! Replays the next update; returns false at the end of the log.
+    bool next() {
+        replay_handler none;
+        return next(none);
+    }
+
+    //! Replays the next update, calling h's hooks (see replay_handler); returns false at the end of the log.
+    template <typename Handler>
+    bool next(Handler& h) {
+        _births = _deaths = 0;
+        // genomes of individuals that died before the previous update are no longer needed:
+        while(!_dead.empty() && (_dead.front().first < _update)) {
+            _genomes.erase(_dead.front().second);
+            _dead.pop_front();
+        }
+
+        boost::uint8_t kind;
+        name_type name;
+        while(read_pod(_f, kind)) {
+            switch(kind) {
+                case FOUNDER: {
+                    individual& ind=_history[name=read<name_type>()];
+                    ind.born = read<boost::uint64_t>();
+                    Genome& g=_genomes[name];
+                    check(read_genome(_f, g));
+                    ind.changes = static_cast<boost::uint32_t>(g.size());
+                    _population.insert(name);
+                    ++_births;
+                    h.birth(*this, name);
+                    break;
+                }
+                case BIRTH: {
+                    individual& ind=_history[name=read<name_type>()];
+                    ind.born = read<boost::uint64_t>();
+                    ind.parents.resize(read<boost::uint8_t>());
+                    for(std::size_t i=0; i<ind.parents.size(); ++i) {
+                        ind.parents[i] = read<name_type>();
+                    }
+                    std::size_t base=read<boost::uint8_t>();
+                    boost::uint32_t count=read<boost::uint32_t>();
+                    Genome& g=_genomes[name];
+                    if(count == FULL) {
+                        check(read_genome(_f, g));
+                        ind.changes = static_cast<boost::uint32_t>(g.size());
+                        if(base < ind.parents.size()) {
+                            const Genome& p=genome(ind.parents[base]);
+                            if(p.size() == g.size()) {
+                                changed_loci(p, g, _loci);
+                                ind.changes = static_cast<boost::uint32_t>(_loci.size());
+                            }
+                        }
+                    } else {
+                        g = genome(ind.parents.at(base));
+                        for(std::size_t i=0; i<count; ++i) {
+                            boost::uint32_t locus=read<boost::uint32_t>();
+                            g[locus] = read<value_type>();
+                        }
+                        ind.changes = count;
+                    }
+                    _population.insert(name);
+                    ++_births;
+                    h.birth(*this, name);
+                    break;
+                }
+                case EVALUATION: {
+                    individual& ind=at(name=read<name_type>());
+                    ind.evaluated = true;
+                    ind.w = read<double>();
+                    ind.w_real = read<double>();
+                    ind.w_eff = read<double>();
+                    h.evaluation(*this, name);
+                    break;
+                }
+                case DEATH: {
+                    name = read<name_type>();
+                    _population.erase(name);
+                    _dead.push_back(std::make_pair(ALIVE, name));
+                    ++_deaths;
+                    h.death(*this, name);
+                    break;
+                }
+                case UPDATE: {
+                    _update = read<boost::uint64_t>();
+                    check(read<boost::uint64_t>() == _population.size());
+                    for(std::size_t i=_dead.size(); (i>0) && (_dead[i-1].first == ALIVE); --i) {
+                        _history[_dead[i-1].second].died = _update;
+                        _dead[i-1].first = _update;
+                    }
+                    h.end_of_update(*this);
+                    return true;
+                }
+                default: {
+                    throw std::runtime_error("run_log: corrupt log");
+                }
+            }
+        }
+        return false; // end of the log, or an update cut short
+    }
+
+    //! Returns the log header.
+    const header& log_header() const { return _header; }
+
+    //! Returns the most recently replayed update.
+    boost::uint64_t update() const { return _update; }
+
+    //! Returns the names of the population, in order.
+    const std::set<name_type>& population() const { return _population; }
+
+    //! Returns the number of individuals born (including immigrants) during the last update.
+    std::size_t births() const { return _births; }
+
+    //! Returns the number of individuals that died during the last update.
+    std::size_t deaths() const { return _deaths; }
+
+    //! Returns the individual called name.
+    const individual& operator[](name_type name) const {
+        typename history_type::const_iterator i=_history.find(name);
+        if(i == _history.end()) {
+            throw std::out_of_range("run_log: unknown individual");
+        }
+        return i->second;
+    }
+
+    //! Returns the genome of a living (or just-dead) individual.
+    const Genome& genome(name_type name) const {
+        typename std::unordered_map<name_type, Genome>::const_iterator i=_genomes.find(name);
+        if(i == _genomes.end()) {
+            throw std::out_of_range("run_log: genome is no longer available");
+        }
+        return i->second;
+    }
+
+    //! Returns true if x is a better fitness than y.
+    bool better(double x, double y) const { return _header.minimize ? ::better(x, y, minimizeS()) : ::better(x, y, maximizeS()); }
+
+    //! Returns the line of descent of name through first parents, from name back to its founder.
+    std::vector<name_type> lineage(name_type name) const {
+        std::vector<name_type> l(1, name);
+        for(const individual* i=&(*this)[name]; !i->parents.empty(); i=&(*this)[l.back()]) {
+            l.push_back(i->parents.front());
+        }
+        return l;
+    }
+
+protected:
+    typedef std::unordered_map<name_type, individual> history_type;
+
+    individual& at(name_type name) {
+        return const_cast<individual&>(static_cast<const replay&>(*this)[name]);
+    }
+
+    template <typename T>
+    T read() {
+        T t;
+        check(read_pod(_f, t));
+        return t;
+    }
+
+    void check(bool ok) {
+        if(!ok) {
+            throw std::runtime_error("run_log: corrupt or truncated log");
+        }
+    }
+
+    std::ifstream _f; //!< Log file.
+    char _buf[1<<16]; //!< Read buffer.
+    header _header; //!< Log header.
+    boost::uint64_t _update; //!< Most recently replayed update.
+    std::size_t _births; //!< Births during the last update.
+    std::size_t _deaths; //!< Deaths during the last update.
+    std::set<name_type> _population; //!< Names of the living.
+    history_type _history; //!< Everyone that has lived.
+    std::unordered_map<name_type, Genome> _genomes; //!< Genomes of the living and the recently dead.
+    std::deque<std::pair<boost::uint64_t, name_type> > _dead; //!< (update of death, name) of the recently dead.
+    std::vector<boost::uint32_t> _loci; //!< Scratch: changed loci.
+};
+
+} // run_log
+
+/*! Records births, evaluations and deaths in run_log.bin if RUN_LOG is set (see
+ above).
+
+ Births are noted when offspring inherit from their parents, and written at
+ the end of the update in which the offspring joins the population, by then
+ with its final genome; offspring that never join it are not recorded.
+ Individuals that join it without a recorded birth are founders (the initial
+ population and immigrants).  Deaths are whoever left the population since
+ the last update.
+
+ The recorder holds on to the population of the last update until the end of
+ this one; random_individuals therefore does not recycle the genome storage
+ of individuals that are recorded as alive.  Breeding and evaluation
+ may run on several threads.  Add it to the EA through static_events (see
+ static_events.h), after anything that changes the population at the end of
+ an update.
+ */
+template <typename EA>
+struct run_recorder {
+    typedef typename EA::individual_type individual_type;
+    typedef typename EA::individual_ptr_type individual_ptr_type;
+    typedef typename EA::population_type population_type;
+    typedef typename EA::genome_type genome_type;
+    typedef typename genome_type::value_type value_type;
+
+    //! A birth that has not been written yet.
+    struct birth {
+        population_type parents; //!< Parents, first parent first.
+        boost::uint64_t born; //!< Update of birth.
+    };
+
+    //! An evaluation that has not been written yet.
+    struct evaluation {
+        double w, w_real, w_eff;
+    };
+
+    run_recorder(EA& ea) : _on(get<RUN_LOG>(ea, 0) != 0) {
+        if(!_on) {
+            return;
+        }
+        _f.open("run_log.bin", std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!_f.is_open()) {
+            throw std::runtime_error("run_recorder: could not open run_log.bin");
+        }
+        _f.write("HRL1", 4);
+        run_log::write_pod(_f, run_log::codec(genome_type()));
+        run_log::write_pod(_f, static_cast<boost::uint32_t>(sizeof(value_type)));
+        run_log::write_pod(_f, direction(typename EA::fitness_function_type::direction_tag()));
+    }
+
+    void inheritance(population_type& parents, individual_type& offspring, EA& ea) {
+        if(!_on) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        birth& b=_births[static_cast<long>(offspring.name())];
+        b.parents = parents;
+        b.born = ea.current_update();
+    }
+
+    void fitness_evaluated(individual_type& ind, EA& ea) {
+        if(!_on) {
+            return;
+        }
+        evaluation e;
+        e.w = static_cast<double>(ind.fitness());
+        e.w_real = get<DELAY_W_REAL>(ind, std::numeric_limits<double>::quiet_NaN());
+        e.w_eff = get<DELAY_W_EFF>(ind, std::numeric_limits<double>::quiet_NaN());
+        std::lock_guard<std::mutex> lock(_mutex);
+        _evaluations[static_cast<long>(ind.name())] = e;
+    }
+
+    void end_of_update(EA& ea) {
+        if(!_on) {
+            return;
+        }
+        boost::uint64_t u=ea.current_update();
+
+        // arrivals:
+        population_type& pop=ea.population();
+        _current.clear();
+        for(typename population_type::iterator i=pop.begin(); i!=pop.end(); ++i) {
+            long name=static_cast<long>((*i)->name());
+            _current.insert(name);
+            arrive(name, *i, u);
+        }
+
+        // evaluations of the living; those of offspring not yet in the population wait:
+        for(typename std::unordered_map<long, evaluation>::iterator i=_evaluations.begin(); i!=_evaluations.end(); ) {
+            if(_alive.count(i->first)) {
+                write_header(run_log::EVALUATION, i->first);
+                run_log::write_pod(_f, i->second.w);
+                run_log::write_pod(_f, i->second.w_real);
+                run_log::write_pod(_f, i->second.w_eff);
+                i = _evaluations.erase(i);
+            } else if(_births.count(i->first)) {
+                ++i;
+            } else {
+                i = _evaluations.erase(i);
+            }
+        }
+
+        // deaths:
+        _departed.clear();
+        for(typename std::unordered_map<long, individual_ptr_type>::iterator i=_alive.begin(); i!=_alive.end(); ) {
+            if(_current.count(i->first)) {
+                ++i;
+            } else {
+                write_header(run_log::DEATH, i->first);
+                _departed.insert(i->first);
+                i = _alive.erase(i);
+            }
+        }
+
+        // offspring born before the previous update will never join the population:
+        for(typename std::unordered_map<long, birth>::iterator i=_births.begin(); i!=_births.end(); ) {
+            if((i->second.born + 1) < u) {
+                i = _births.erase(i);
+            } else {
+                ++i;
+            }
+        }
+
+        run_log::write_pod(_f, static_cast<boost::uint8_t>(run_log::UPDATE));
+        run_log::write_pod(_f, u);
+        run_log::write_pod(_f, static_cast<boost::uint64_t>(_alive.size()));
+        _f.flush();
+    }
+
+    /*! Records the arrival of an individual that is not yet recorded as
+     alive: its birth, if it has one, or else as a founder.  Parents that have
+     not been recorded (e.g., founders that died before the first update
+     ended) are recorded first, and die again at once.
+     */
+    void arrive(long name, individual_ptr_type p, boost::uint64_t u) {
+        if(_alive.count(name) || _departed.count(name)) {
+            return;
+        }
+        typename std::unordered_map<long, birth>::iterator b=_births.find(name);
+        if((b != _births.end()) && (get<IND_GENERATION>(*p, 0.0) > 0.0)) {
+            birth r=b->second;
+            _births.erase(b);
+            for(std::size_t j=0; j<r.parents.size(); ++j) {
+                arrive(static_cast<long>(r.parents[j]->name()), r.parents[j], u);
+            }
+            write_birth(*p, r);
+        } else {
+            // a founder, or an immigrant:
+            if(b != _births.end()) {
+                _births.erase(b);
+            }
+            write_header(run_log::FOUNDER, name);
+            run_log::write_pod(_f, u);
+            run_log::write_genome(_f, static_cast<const genome_type&>(p->genome()));
+        }
+        _alive[name] = p;
+    }
+
+    //! Writes the birth of ind, relative to the closest of its parents.
+    void write_birth(individual_type& ind, const birth& b) {
+        const genome_type& g=ind.genome();
+        std::size_t base=0;
+        bool full=true;
+        for(std::size_t j=0; (j<b.parents.size()) && (j<256); ++j) {
+            const genome_type& p=b.parents[j]->genome();
+            if(p.size() != g.size()) {
+                continue;
+            }
+            run_log::changed_loci(p, g, _scratch);
+            if(full || (_scratch.size() < _loci.size())) {
+                full = false;
+                base = j;
+                _loci.swap(_scratch);
+            }
+        }
+        full = full || ((_loci.size() * (sizeof(boost::uint32_t) + sizeof(value_type))) >= run_log::genome_size(g));
+
+        write_header(run_log::BIRTH, static_cast<long>(ind.name()));
+        run_log::write_pod(_f, b.born);
+        std::size_t n=std::min(b.parents.size(), static_cast<std::size_t>(255));
+        run_log::write_pod(_f, static_cast<boost::uint8_t>(n));
+        for(std::size_t j=0; j<n; ++j) {
+            run_log::write_pod(_f, static_cast<boost::uint64_t>(b.parents[j]->name()));
+        }
+        run_log::write_pod(_f, static_cast<boost::uint8_t>(base));
+        if(full) {
+            run_log::write_pod(_f, run_log::FULL);
+            run_log::write_genome(_f, g);
+        } else {
+            run_log::write_pod(_f, static_cast<boost::uint32_t>(_loci.size()));
+            for(std::size_t j=0; j<_loci.size(); ++j) {
+                run_log::write_pod(_f, _loci[j]);
+                run_log::write_pod(_f, static_cast<value_type>(g[_loci[j]]));
+            }
+        }
+    }
+
+    void write_header(boost::uint8_t kind, long name) {
+        run_log::write_pod(_f, kind);
+        run_log::write_pod(_f, static_cast<boost::uint64_t>(name));
+    }
+
+    static boost::uint32_t direction(maximizeS) { return 0; }
+    static boost::uint32_t direction(minimizeS) { return 1; }
+
+    bool _on; //!< True if recording.
+    std::ofstream _f; //!< Log file.
+    std::mutex _mutex; //!< Guards _births and _evaluations.
+    std::unordered_map<long, birth> _births; //!< Births that have not been written.
+    std::unordered_map<long, evaluation> _evaluations; //!< Evaluations that have not been written.
+    std::unordered_map<long, individual_ptr_type> _alive; //!< Population at the end of the last update.
+    std::unordered_set<long> _current; //!< Scratch: names of the population.
+    std::unordered_set<long> _departed; //!< Names of those that died during the last update.
+    std::vector<boost::uint32_t> _loci, _scratch; //!< Scratch: changed loci.
+};
+
+#endif
@@ -0,0 +1,290 @@
+/* spatial_index.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _SPATIAL_INDEX_H_
+#define _SPATIAL_INDEX_H_
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "packed_bitstring.h"
+
+/* Nearest-neighbor indices over genomes, for diversity-aware selection.
+
+ Each index stores pointers to genomes, which must outlive it (or at least
+ its next clear()), and hands out a node id per insert.  Queries take a
+ filter, called with node ids, so that callers can retire entries without
+ rebuilding the index.  nn_index<Genome> picks the index for a genome type.
+ */
+
+//! Always-true node filter.
+struct any_node {
+    bool operator()(std::size_t) const { return true; }
+};
+
+/*! BK-tree (Burkhard & Keller, 1973) over packed bitstrings under Hamming
+ distance.
+
+ Each child edge is labeled with its distance to the parent, and the triangle
+ inequality prunes every subtree whose label differs from the query's
+ distance to the parent by more than the search radius.  Distances are a
+ popcount per word.
+ */
+class bk_tree {
+public:
+    typedef packed_bitstring point_type;
+
+    //! Removes all points.
+    void clear() { _nodes.clear(); }
+
+    //! Reserves space for n points.
+    void reserve(std::size_t n) { _nodes.reserve(n); }
+
+    //! Returns the number of points.
+    std::size_t size() const { return _nodes.size(); }
+
+    //! Inserts p, returning its node id.
+    std::size_t insert(const point_type& p) {
+        std::size_t id=_nodes.size();
+        _nodes.push_back(node(&p));
+        if(id == 0) {
+            return id;
+        }
+        std::size_t i=0;
+        while(true) {
+            std::size_t d=hamming_distance(p, *_nodes[i].p);
+            std::size_t c=_nodes[i].child(d);
+            if(c == 0) {
+                _nodes[i].children.push_back(std::make_pair(d, id));
+                return id;
+            }
+            i = c;
+        }
+    }
+
+    /*! Returns the distance from q to the nearest point accepted by f, and
+     sets id to its node id (or returns infinity if there is none).
+     */
+    template <typename Filter>
+    double nearest(const point_type& q, Filter f, std::size_t& id) const {
+        std::size_t best=std::numeric_limits<std::size_t>::max();
+        if(!_nodes.empty()) {
+            _stack.assign(1, 0);
+            while(!_stack.empty()) {
+                const node& n=_nodes[_stack.back()];
+                std::size_t ni=_stack.back();
+                _stack.pop_back();
+                std::size_t d=hamming_distance(q, *n.p);
+                if((d < best) && f(ni)) {
+                    best = d;
+                    id = ni;
+                }
+                for(std::size_t j=0; j<n.children.size(); ++j) {
+                    std::size_t e=n.children[j].first;
+                    if(((e > d) ? (e - d) : (d - e)) < best) {
+                        _stack.push_back(n.children[j].second);
+                    }
+                }
+            }
+        }
+        return (best == std::numeric_limits<std::size_t>::max()) ? std::numeric_limits<double>::infinity() : best;
+    }
+
+    //! Appends to out the ids of the points accepted by f within distance r of q.
+    template <typename Filter>
+    void within(const point_type& q, double r, Filter f, std::vector<std::size_t>& out) const {
+        if(_nodes.empty()) {
+            return;
+        }
+        _stack.assign(1, 0);
+        while(!_stack.empty()) {
+            std::size_t ni=_stack.back();
+            const node& n=_nodes[ni];
+            _stack.pop_back();
+            double d=hamming_distance(q, *n.p);
+            if((d <= r) && f(ni)) {
+                out.push_back(ni);
+            }
+            for(std::size_t j=0; j<n.children.size(); ++j) {
+                if(std::fabs(static_cast<double>(n.children[j].first) - d) <= r) {
+                    _stack.push_back(n.children[j].second);
+                }
+            }
+        }
+    }
+
+protected:
+    struct node {
+        node(const point_type* x) : p(x) {
+        }
+
+        //! Returns the child at distance d, or 0 if there is none.
+        std::size_t child(std::size_t d) const {
+            for(std::size_t i=0; i<children.size(); ++i) {
+                if(children[i].first == d) {
+                    return children[i].second;
+                }
+            }
+            return 0;
+        }
+
+        const point_type* p; //!< Point.
+        std::vector<std::pair<std::size_t, std::size_t> > children; //!< (distance, node id).
+    };
+
+    std::vector<node> _nodes; //!< Nodes; the root is node 0.
+    mutable std::vector<std::size_t> _stack; //!< Scratch space for queries.
+};
+
+/*! k-d tree over real-valued vectors under Euclidean distance.
+
+ Points are inserted as leaves, splitting on dimension (depth mod D).  The
+ tree is not rebalanced, which is adequate for populations, whose insertion
+ order is essentially random.
+ */
+class kd_tree {
+public:
+    typedef std::vector<double> point_type;
+
+    //! Removes all points.
+    void clear() { _nodes.clear(); }
+
+    //! Reserves space for n points.
+    void reserve(std::size_t n) { _nodes.reserve(n); }
+
+    //! Returns the number of points.
+    std::size_t size() const { return _nodes.size(); }
+
+    //! Inserts p, returning its node id.
+    std::size_t insert(const point_type& p) {
+        std::size_t id=_nodes.size();
+        _nodes.push_back(node(&p));
+        if(id == 0) {
+            return id;
+        }
+        std::size_t i=0, depth=0;
+        while(true) {
+            std::size_t a=depth % p.size();
+            std::size_t& c=(p[a] < (*_nodes[i].p)[a]) ? _nodes[i].left : _nodes[i].right;
+            if(c == 0) {
+                c = id;
+                return id;
+            }
+            i = c;
+            ++depth;
+        }
+    }
+
+    /*! Returns the distance from q to the nearest point accepted by f, and
+     sets id to its node id (or returns infinity if there is none).
+     */
+    template <typename Filter>
+    double nearest(const point_type& q, Filter f, std::size_t& id) const {
+        double best=std::numeric_limits<double>::infinity();
+        if(!_nodes.empty()) {
+            search(0, 0, q, f, best, id);
+        }
+        return std::sqrt(best);
+    }
+
+    //! Appends to out the ids of the points accepted by f within distance r of q.
+    template <typename Filter>
+    void within(const point_type& q, double r, Filter f, std::vector<std::size_t>& out) const {
+        if(!_nodes.empty()) {
+            collect(0, 0, q, r*r, f, out);
+        }
+    }
+
+protected:
+    struct node {
+        node(const point_type* x) : p(x), left(0), right(0) {
+        }
+
+        const point_type* p; //!< Point.
+        std::size_t left; //!< Child with smaller coordinate (0 if none).
+        std::size_t right; //!< Child with larger or equal coordinate (0 if none).
+    };
+
+    //! Returns the squared distance between a and b.
+    static double distance2(const point_type& a, const point_type& b) {
+        double d=0.0;
+        for(std::size_t i=0; i<a.size(); ++i) {
+            double x=a[i]-b[i];
+            d += x*x;
+        }
+        return d;
+    }
+
+    template <typename Filter>
+    void search(std::size_t i, std::size_t depth, const point_type& q, Filter f, double& best, std::size_t& id) const {
+        const node& n=_nodes[i];
+        double d=distance2(q, *n.p);
+        if((d < best) && f(i)) {
+            best = d;
+            id = i;
+        }
+        std::size_t a=depth % q.size();
+        double diff=q[a] - (*n.p)[a];
+        std::size_t near=(diff < 0.0) ? n.left : n.right;
+        std::size_t far=(diff < 0.0) ? n.right : n.left;
+        if(near != 0) {
+            search(near, depth+1, q, f, best, id);
+        }
+        if((far != 0) && ((diff*diff) < best)) {
+            search(far, depth+1, q, f, best, id);
+        }
+    }
+
+    template <typename Filter>
+    void collect(std::size_t i, std::size_t depth, const point_type& q, double r2, Filter f, std::vector<std::size_t>& out) const {
+        const node& n=_nodes[i];
+        if((distance2(q, *n.p) <= r2) && f(i)) {
+            out.push_back(i);
+        }
+        std::size_t a=depth % q.size();
+        double diff=q[a] - (*n.p)[a];
+        if((n.left != 0) && ((diff < 0.0) || ((diff*diff) <= r2))) {
+            collect(n.left, depth+1, q, r2, f, out);
+        }
+        if((n.right != 0) && ((diff >= 0.0) || ((diff*diff) <= r2))) {
+            collect(n.right, depth+1, q, r2, f, out);
+        }
+    }
+
+    std::vector<node> _nodes; //!< Nodes; the root is node 0.
+};
+
+//! Selects the nearest-neighbor index for a genome type.
+template <typename Genome>
+struct nn_index;
+
+template <>
+struct nn_index<packed_bitstring> {
+    typedef bk_tree type;
+};
+
+template <>
+struct nn_index<std::vector<double> > {
+    typedef kd_tree type;
+};
+
+#endif
@@ -0,0 +1,210 @@
+/* static_events.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _STATIC_EVENTS_H_
+#define _STATIC_EVENTS_H_
+
+#include <memory>
+#include <utility>
+
+#include <ea/events.h>
+
+using namespace ealib;
+
+/* Event handlers dispatched without virtual calls.
+
+ A handler is a plain class template over the EA, constructed from the EA,
+ with any of the following non-virtual member functions:
+
+    void fitness_evaluated(typename EA::individual_type& ind, EA& ea);
+    void inheritance(typename EA::population_type& parents, typename EA::individual_type& offspring, EA& ea);
+    void end_of_update(EA& ea);
+    void record_statistics(EA& ea);
+
+ static_events<H1, H2, ...>::type is a single event that holds all of the
+ handlers, and is registered like any other:
+
+    typedef static_events<effective_fitness, dominant_archive> delay_events;
+    ...
+    add_event<delay_events::type>(ea);
+
+ It connects one virtual adapter to each of the EA's signals that at least
+ one handler listens to, and calls the handlers from there in list order
+ through direct (inlinable) calls.  A fitness_evaluated signal thus costs one
+ indirect call however many handlers listen to it.  Handlers run at the point
+ where the pipeline was added, relative to runtime-registered events.
+
+ Events from libea (e.g., datafiles::fitness_dat, lod_event) and those added
+ by tools and analyses keep using runtime registration.  A single handler is
+ registered on its own with add_event<static_events<H>::type>.
+ */
+
+namespace detail {
+
+    //! Defines a trait that is true if H has a member function f callable with the given arguments.
+#define HIMALAYA_HAS_HOOK(name, f, args) \
+    template <typename H, typename EA> \
+    struct name { \
+        template <typename T> static char test(decltype(std::declval<T&>().f args)*); \
+        template <typename T> static long test(...); \
+        static const bool value = (sizeof(test<H>(0)) == sizeof(char)); \
+    };
+
+    HIMALAYA_HAS_HOOK(has_fitness_evaluated, fitness_evaluated,
+                      (std::declval<typename EA::individual_type&>(), std::declval<EA&>()))
+    HIMALAYA_HAS_HOOK(has_inheritance, inheritance,
+                      (std::declval<typename EA::population_type&>(), std::declval<typename EA::individual_type&>(), std::declval<EA&>()))
+    HIMALAYA_HAS_HOOK(has_end_of_update, end_of_update, (std::declval<EA&>()))
+    HIMALAYA_HAS_HOOK(has_record_statistics, record_statistics, (std::declval<EA&>()))
+#undef HIMALAYA_HAS_HOOK
+
+    //! True if any of the traits is true.
+    template <bool... B> struct any;
+    template <> struct any<> { static const bool value = false; };
+    template <bool B, bool... Bs> struct any<B,Bs...> { static const bool value = B || any<Bs...>::value; };
+
+    //! Calls h's hook if it has one; otherwise does nothing.
+    template <typename H, typename EA>
+    void fitness_evaluated(H& h, typename EA::individual_type& ind, EA& ea, std::true_type) { h.fitness_evaluated(ind, ea); }
+    template <typename H, typename EA>
+    void fitness_evaluated(H&, typename EA::individual_type&, EA&, std::false_type) { }
+
+    template <typename H, typename EA>
+    void inheritance(H& h, typename EA::population_type& p, typename EA::individual_type& o, EA& ea, std::true_type) { h.inheritance(p, o, ea); }
+    template <typename H, typename EA>
+    void inheritance(H&, typename EA::population_type&, typename EA::individual_type&, EA&, std::false_type) { }
+
+    template <typename H, typename EA>
+    void end_of_update(H& h, EA& ea, std::true_type) { h.end_of_update(ea); }
+    template <typename H, typename EA>
+    void end_of_update(H&, EA&, std::false_type) { }
+
+    template <typename H, typename EA>
+    void record_statistics(H& h, EA& ea, std::true_type) { h.record_statistics(ea); }
+    template <typename H, typename EA>
+    void record_statistics(H&, EA&, std::false_type) { }
+
+} // detail
+
+/*! A compile-time list of event handlers; see above.
+ */
+template <template <typename> class... Handlers>
+struct static_events {
+
+    //! The event that holds and dispatches to the handlers; handlers are its bases, constructed in list order.
+    template <typename EA>
+    struct type : event, Handlers<EA>... {
+        typedef typename EA::individual_type individual_type;
+        typedef typename EA::population_type population_type;
+
+        static const bool any_fitness_evaluated = detail::any<detail::has_fitness_evaluated<Handlers<EA>,EA>::value...>::value;
+        static const bool any_inheritance = detail::any<detail::has_inheritance<Handlers<EA>,EA>::value...>::value;
+        static const bool any_end_of_update = detail::any<detail::has_end_of_update<Handlers<EA>,EA>::value...>::value;
+        static const bool any_record_statistics = detail::any<detail::has_record_statistics<Handlers<EA>,EA>::value...>::value;
+
+        //! Adapters from the EA's (virtual) event signals to the handlers.
+        struct fitness_evaluated_adapter : fitness_evaluated_event<EA> {
+            fitness_evaluated_adapter(type& t, EA& ea) : fitness_evaluated_event<EA>(ea), _t(t) { }
+            virtual ~fitness_evaluated_adapter() { }
+            virtual void operator()(individual_type& ind, EA& ea) { _t.fitness_evaluated(ind, ea); }
+            type& _t;
+        };
+
+        struct inheritance_adapter : inheritance_event<EA> {
+            inheritance_adapter(type& t, EA& ea) : inheritance_event<EA>(ea), _t(t) { }
+            virtual ~inheritance_adapter() { }
+            virtual void operator()(population_type& p, individual_type& o, EA& ea) { _t.inheritance(p, o, ea); }
+            type& _t;
+        };
+
+        struct end_of_update_adapter : end_of_update_event<EA> {
+            end_of_update_adapter(type& t, EA& ea) : end_of_update_event<EA>(ea), _t(t) { }
+            virtual ~end_of_update_adapter() { }
+            virtual void operator()(EA& ea) { _t.end_of_update(ea); }
+            type& _t;
+        };
+
+        struct record_statistics_adapter : record_statistics_event<EA> {
+            record_statistics_adapter(type& t, EA& ea) : record_statistics_event<EA>(ea), _t(t) { }
+            virtual ~record_statistics_adapter() { }
+            virtual void operator()(EA& ea) { _t.record_statistics(ea); }
+            type& _t;
+        };
+
+        //! Constructor; constructs the handlers, and connects only the signals they listen to.
+        type(EA& ea) : Handlers<EA>(ea)... {
+            if(any_fitness_evaluated) {
+                _fitness_evaluated.reset(new fitness_evaluated_adapter(*this, ea));
+            }
+            if(any_inheritance) {
+                _inheritance.reset(new inheritance_adapter(*this, ea));
+            }
+            if(any_end_of_update) {
+                _end_of_update.reset(new end_of_update_adapter(*this, ea));
+            }
+            if(any_record_statistics) {
+                _record_statistics.reset(new record_statistics_adapter(*this, ea));
+            }
+        }
+
+        virtual ~type() {
+        }
+
+        //! Calls each handler's fitness_evaluated, in list order.
+        void fitness_evaluated(individual_type& ind, EA& ea) {
+            int expand[] = {0, (detail::fitness_evaluated(static_cast<Handlers<EA>&>(*this), ind, ea,
+                                                          std::integral_constant<bool, detail::has_fitness_evaluated<Handlers<EA>,EA>::value>()), 0)...};
+            (void)expand;
+        }
+
+        //! Calls each handler's inheritance, in list order.
+        void inheritance(population_type& p, individual_type& o, EA& ea) {
+            int expand[] = {0, (detail::inheritance(static_cast<Handlers<EA>&>(*this), p, o, ea,
+                                                    std::integral_constant<bool, detail::has_inheritance<Handlers<EA>,EA>::value>()), 0)...};
+            (void)expand;
+        }
+
+        //! Calls each handler's end_of_update, in list order.
+        void end_of_update(EA& ea) {
+            int expand[] = {0, (detail::end_of_update(static_cast<Handlers<EA>&>(*this), ea,
+                                                      std::integral_constant<bool, detail::has_end_of_update<Handlers<EA>,EA>::value>()), 0)...};
+            (void)expand;
+        }
+
+        //! Calls each handler's record_statistics, in list order.
+        void record_statistics(EA& ea) {
+            int expand[] = {0, (detail::record_statistics(static_cast<Handlers<EA>&>(*this), ea,
+                                                          std::integral_constant<bool, detail::has_record_statistics<Handlers<EA>,EA>::value>()), 0)...};
+            (void)expand;
+        }
+
+        //! Returns handler H.
+        template <template <typename> class H>
+        H<EA>& handler() {
+            return static_cast<H<EA>&>(*this);
+        }
+
+        std::unique_ptr<fitness_evaluated_adapter> _fitness_evaluated;
+        std::unique_ptr<inheritance_adapter> _inheritance;
+        std::unique_ptr<end_of_update_adapter> _end_of_update;
+        std::unique_ptr<record_statistics_adapter> _record_statistics;
+    };
+};
+
+#endif
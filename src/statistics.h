@@ -0,0 +1,201 @@
+/* statistics.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _STATISTICS_H_
+#define _STATISTICS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "counting_allocator.h"
+
+/* Summary statistics over contiguous arrays of doubles.
+
+ The reductions below keep four independent partial results, which breaks the
+ loop-carried dependency of a naive reduction and lets the compiler keep them
+ in one vector register.  Nothing here allocates, except sample, which keeps
+ its capacity between uses.
+ */
+
+namespace statistics {
+
+/*! Summary statistics of a sample.
+ */
+struct summary {
+    summary() : n(0), mean(0.0), min(0.0), max(0.0), variance(0.0) {
+    }
+
+    std::size_t n; //!< Sample size.
+    double mean; //!< Sample mean.
+    double min; //!< Minimum.
+    double max; //!< Maximum.
+    double variance; //!< Unbiased sample variance (0 if n < 2).
+};
+
+//! Returns the sum of [x, x+n).
+inline double sum(const double* x, std::size_t n) {
+    double s0=0.0, s1=0.0, s2=0.0, s3=0.0;
+    std::size_t i=0;
+    for( ; (i+4)<=n; i+=4) {
+        s0 += x[i]; s1 += x[i+1]; s2 += x[i+2]; s3 += x[i+3];
+    }
+    for( ; i<n; ++i) {
+        s0 += x[i];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+//! Returns the maximum of [x, x+n), or 0 if n is 0.
+inline double max(const double* x, std::size_t n) {
+    if(n == 0) {
+        return 0.0;
+    }
+    double h0=x[0], h1=x[0], h2=x[0], h3=x[0];
+    std::size_t i=0;
+    for( ; (i+4)<=n; i+=4) {
+        h0 = std::max(h0,x[i]); h1 = std::max(h1,x[i+1]); h2 = std::max(h2,x[i+2]); h3 = std::max(h3,x[i+3]);
+    }
+    for( ; i<n; ++i) {
+        h0 = std::max(h0,x[i]);
+    }
+    return std::max(std::max(h0,h1), std::max(h2,h3));
+}
+
+//! Returns the mean of [x, x+n), or 0 if n is 0.
+inline double mean(const double* x, std::size_t n) {
+    return (n > 0) ? (sum(x,n) / static_cast<double>(n)) : 0.0;
+}
+
+//! Returns the summary statistics of [x, x+n).
+inline summary summarize(const double* x, std::size_t n) {
+    summary s;
+    s.n = n;
+    if(n == 0) {
+        return s;
+    }
+
+    // first pass: sum, min, and max:
+    double s0=0.0, s1=0.0, s2=0.0, s3=0.0;
+    double l0=x[0], l1=x[0], l2=x[0], l3=x[0];
+    double h0=x[0], h1=x[0], h2=x[0], h3=x[0];
+    std::size_t i=0;
+    for( ; (i+4)<=n; i+=4) {
+        s0 += x[i]; s1 += x[i+1]; s2 += x[i+2]; s3 += x[i+3];
+        l0 = std::min(l0,x[i]); l1 = std::min(l1,x[i+1]); l2 = std::min(l2,x[i+2]); l3 = std::min(l3,x[i+3]);
+        h0 = std::max(h0,x[i]); h1 = std::max(h1,x[i+1]); h2 = std::max(h2,x[i+2]); h3 = std::max(h3,x[i+3]);
+    }
+    for( ; i<n; ++i) {
+        s0 += x[i];
+        l0 = std::min(l0,x[i]);
+        h0 = std::max(h0,x[i]);
+    }
+    s.mean = ((s0 + s1) + (s2 + s3)) / static_cast<double>(n);
+    s.min = std::min(std::min(l0,l1), std::min(l2,l3));
+    s.max = std::max(std::max(h0,h1), std::max(h2,h3));
+
+    // second pass: squared deviations from the mean, which is more accurate
+    // than accumulating sum(x^2) in the first pass:
+    if(n > 1) {
+        const double m=s.mean;
+        double v0=0.0, v1=0.0, v2=0.0, v3=0.0;
+        for(i=0; (i+4)<=n; i+=4) {
+            double d0=x[i]-m, d1=x[i+1]-m, d2=x[i+2]-m, d3=x[i+3]-m;
+            v0 += d0*d0; v1 += d1*d1; v2 += d2*d2; v3 += d3*d3;
+        }
+        for( ; i<n; ++i) {
+            double d=x[i]-m;
+            v0 += d*d;
+        }
+        s.variance = ((v0 + v1) + (v2 + v3)) / static_cast<double>(n-1);
+    }
+    return s;
+}
+
+/*! Returns the q'th quantile (0 <= q <= 1) of [x, x+n), linearly interpolating
+ between order statistics.
+
+ The elements of x are reordered.
+ */
+inline double quantile(double* x, std::size_t n, double q) {
+    if(n == 0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    double h=q * static_cast<double>(n-1);
+    std::size_t lo=static_cast<std::size_t>(std::floor(h));
+    if(lo >= (n-1)) {
+        return *std::max_element(x, x+n);
+    }
+    std::nth_element(x, x+lo, x+n);
+    double a=x[lo];
+    double b=*std::min_element(x+lo+1, x+n);
+    return a + (h - static_cast<double>(lo)) * (b - a);
+}
+
+/*! A sample of doubles whose storage is reused from one use to the next.
+
+ Typical use is as a member of an event: clear() it, push_back() one value per
+ individual, and then query it.  Once the buffer has grown to the population
+ size, no further allocation takes place.
+ */
+class sample {
+public:
+    //! Removes all values, keeping capacity.
+    void clear() { _x.clear(); }
+
+    //! Reserves space for n values.
+    void reserve(std::size_t n) { _x.reserve(n); _scratch.reserve(n); }
+
+    //! Adds a value.
+    void push_back(double v) { _x.push_back(v); }
+
+    //! Returns the number of values.
+    std::size_t size() const { return _x.size(); }
+
+    //! Returns true if there are no values.
+    bool empty() const { return _x.empty(); }
+
+    //! Returns a pointer to the values.
+    const double* data() const { return _x.empty() ? 0 : &_x[0]; }
+
+    //! Returns the mean, or 0 if there are no values.
+    double mean() const { return statistics::mean(data(), size()); }
+
+    //! Returns the maximum, or 0 if there are no values.
+    double max() const { return statistics::max(data(), size()); }
+
+    //! Returns the summary statistics.
+    summary summarize() const { return statistics::summarize(data(), size()); }
+
+    //! Returns the q'th quantile, leaving the values in their original order.
+    double quantile(double q) {
+        _scratch.assign(_x.begin(), _x.end());
+        return statistics::quantile(_scratch.empty() ? 0 : &_scratch[0], _scratch.size(), q);
+    }
+
+protected:
+    typedef std::vector<double, memory::counting_allocator<double, memory::BUFFERS> > buffer_type;
+    buffer_type _x; //!< Values.
+    buffer_type _scratch; //!< Working space for quantiles.
+};
+
+} // statistics
+
+#endif
@@ -0,0 +1,136 @@
+/* stopping.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _STOPPING_H_
+#define _STOPPING_H_
+
+#include <limits>
+#include <memory>
+#include <string>
+
+#include <ea/metadata.h>
+#include <ea/datafile.h>
+
+#include "delay.h"
+
+using namespace ealib;
+
+//! Stop once the best real fitness reaches this value.
+LIBEA_MD_DECL(STOP_TARGET_W, "stop.target_w", double);
+//! Stop after this many updates without an improvement in the best real fitness (0 disables).
+LIBEA_MD_DECL(STOP_STAGNATION_WINDOW, "stop.stagnation_window", int);
+//! Stop once this many fitness evaluations have been performed (0 disables).
+LIBEA_MD_DECL(STOP_EVALUATION_BUDGET, "stop.evaluation_budget", double);
+
+// State kept by stop_monitor, stored as EA metadata so that it is checkpointed:
+LIBEA_MD_DECL(STOP_EVALUATIONS, "stop.state.evaluations", double);
+LIBEA_MD_DECL(STOP_BEST_W, "stop.state.best_w", double);
+LIBEA_MD_DECL(STOP_LAST_IMPROVEMENT, "stop.state.last_improvement", int);
+
+/*! Tracks the number of fitness evaluations, the best real fitness
+ (DELAY_W_REAL if present, otherwise fitness), and the update at which it last
+ improved.  Better is as defined by the fitness function's direction_tag.
+
+ Tracking costs a few comparisons per evaluation; the totals are copied to
+ the EA's metadata once per update, where convergence_stop reads them.  This
+ handler (see static_events.h) must be added to any EA that uses
+ convergence_stop.
+ */
+template <typename EA>
+struct stop_monitor {
+    typedef typename EA::fitness_function_type::direction_tag direction_tag;
+
+    //! Constructor; resumes from the EA's metadata, if present (e.g., after a checkpoint).
+    stop_monitor(EA& ea)
+    : _evaluations(get<STOP_EVALUATIONS>(ea, 0.0))
+    , _best(get<STOP_BEST_W>(ea, worst(direction_tag())))
+    , _last_improvement(get<STOP_LAST_IMPROVEMENT>(ea, 0)) {
+    }
+
+    void fitness_evaluated(typename EA::individual_type& ind, EA& ea) {
+        ++_evaluations;
+        double w=real_fitness(ind);
+        if(better(w, _best, direction_tag())) {
+            _best = w;
+            _last_improvement = ea.current_update();
+        }
+    }
+
+    //! Copies the running totals into the EA's metadata.
+    void end_of_update(EA& ea) {
+        put<STOP_EVALUATIONS>(_evaluations, ea);
+        put<STOP_BEST_W>(_best, ea);
+        put<STOP_LAST_IMPROVEMENT>(_last_improvement, ea);
+    }
+
+    double _evaluations; //!< Fitness evaluations so far.
+    double _best; //!< Best real fitness so far.
+    int _last_improvement; //!< Update at which _best was found.
+};
+
+/*! Stops the run when the best real fitness reaches STOP_TARGET_W (is at
+ least as good as it, in the fitness function's direction), when it has not
+ improved for STOP_STAGNATION_WINDOW updates, or when STOP_EVALUATION_BUDGET
+ evaluations have been performed, whichever comes first.  Each condition is
+ disabled unless its option is set.
+
+ The budget is checked between updates, so a run may overshoot it by up to
+ one update's worth of evaluations.  Why and when the run stopped is written
+ to stop.dat.  Requires stop_monitor.
+ */
+struct convergence_stop {
+    template <typename EA>
+    bool operator()(EA& ea) {
+        if(!exists<STOP_EVALUATIONS>(ea)) {
+            return false;
+        }
+        double evaluations=get<STOP_EVALUATIONS>(ea);
+        double best=get<STOP_BEST_W>(ea);
+        int window=get<STOP_STAGNATION_WINDOW>(ea, 0);
+        double budget=get<STOP_EVALUATION_BUDGET>(ea, 0.0);
+
+        typedef typename EA::fitness_function_type::direction_tag direction_tag;
+        std::string reason;
+        if(exists<STOP_TARGET_W>(ea) && !better(get<STOP_TARGET_W>(ea), best, direction_tag())) {
+            reason = "target";
+        } else if((window > 0) && ((static_cast<int>(ea.current_update()) - get<STOP_LAST_IMPROVEMENT>(ea)) >= window)) {
+            reason = "stagnation";
+        } else if((budget > 0.0) && (evaluations >= budget)) {
+            reason = "budget";
+        } else {
+            return false;
+        }
+
+        datafile df("stop.dat");
+        df.add_field("update")
+        .add_field("reason")
+        .add_field("evaluations")
+        .add_field("best_w_real")
+        .add_field("last_improvement");
+        df.write(ea.current_update())
+        .write(reason)
+        .write(evaluations)
+        .write(best)
+        .write(get<STOP_LAST_IMPROVEMENT>(ea))
+        .endl();
+        return true;
+    }
+};
+
+#endif
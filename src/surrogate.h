@@ -0,0 +1,218 @@
+/* surrogate.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _SURROGATE_H_
+#define _SURROGATE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <ea/metadata.h>
+#include <ea/generational_models/steady_state.h>
+
+#include "delay.h"
+#include "evaluation.h"
+#include "spatial_index.h"
+
+using namespace ealib;
+
+//! Candidate offspring bred per offspring that is evaluated (1 disables pre-screening).
+LIBEA_MD_DECL(SURROGATE_OVERSAMPLE, "surrogate.oversample", double);
+//! Number of recent evaluations the surrogate remembers.
+LIBEA_MD_DECL(SURROGATE_ARCHIVE, "surrogate.archive", int);
+//! Number of nearest neighbors a prediction is based on.
+LIBEA_MD_DECL(SURROGATE_K, "surrogate.k", int);
+
+/*! Nearest-neighbor model of real fitness over recently evaluated genomes.
+
+ The model remembers the last capacity genomes added to it, in a ring
+ buffer, and predicts the fitness of a genome as the inverse-distance-weighted
+ mean of the fitnesses of its k nearest neighbors (see nn_index).  The index
+ is rebuilt by rebuild(), once per batch of additions.
+ */
+template <typename Genome>
+class knn_surrogate {
+public:
+    typedef typename nn_index<Genome>::type index_type;
+
+    //! Constructor.
+    knn_surrogate(std::size_t capacity=1000, std::size_t k=5)
+    : _capacity(std::max(capacity, static_cast<std::size_t>(1))), _k(std::max(k, static_cast<std::size_t>(1))), _next(0) {
+        _x.reserve(_capacity);
+        _w.reserve(_capacity);
+        _index.reserve(_capacity);
+    }
+
+    //! Returns the number of genomes remembered.
+    std::size_t size() const { return _x.size(); }
+
+    //! Returns true if there are enough genomes to predict from.
+    bool ready() const { return _x.size() >= _k; }
+
+    //! Remembers that g has fitness w, forgetting the oldest genome if full.
+    void add(const Genome& g, double w) {
+        if(_x.size() < _capacity) {
+            _x.push_back(g);
+            _w.push_back(w);
+        } else {
+            _x[_next] = g;
+            _w[_next] = w;
+        }
+        _next = (_next + 1) % _capacity;
+    }
+
+    //! Rebuilds the index after genomes were added.
+    void rebuild() {
+        _index.clear();
+        for(std::size_t i=0; i<_x.size(); ++i) {
+            _index.insert(_x[i]);
+        }
+    }
+
+    //! Returns the predicted fitness of g.
+    double predict(const Genome& g) {
+        _found.clear();
+        double sw=0.0, swx=0.0;
+        for(std::size_t j=0; (j<_k) && (j<_x.size()); ++j) {
+            std::size_t id=0;
+            double d=_index.nearest(g, not_found(_found), id);
+            if(d == 0.0) {
+                return _w[id];
+            }
+            _found.push_back(id);
+            sw += 1.0 / d;
+            swx += _w[id] / d;
+        }
+        return (sw > 0.0) ? (swx / sw) : 0.0;
+    }
+
+protected:
+    //! Accepts the points that have not been found yet.
+    struct not_found {
+        not_found(const std::vector<std::size_t>& f) : _f(f) { }
+        bool operator()(std::size_t i) const { return std::find(_f.begin(), _f.end(), i) == _f.end(); }
+        const std::vector<std::size_t>& _f;
+    };
+
+    std::size_t _capacity; //!< Genomes remembered.
+    std::size_t _k; //!< Neighbors per prediction.
+    std::size_t _next; //!< Ring-buffer position of the next genome.
+    std::vector<Genome> _x; //!< Genomes; index nodes point into this, which never reallocates.
+    std::vector<double> _w; //!< Their fitnesses.
+    index_type _index; //!< Nearest-neighbor index over _x.
+    std::vector<std::size_t> _found; //!< Scratch space for predictions.
+};
+
+/*! Steady-state generational model that screens offspring with a surrogate.
+
+ Each update, SURROGATE_OVERSAMPLE*STEADY_STATE_LAMBDA candidate offspring are
+ bred, ranked by a knn_surrogate of real fitness (DELAY_W_REAL if present,
+ otherwise fitness), and only the STEADY_STATE_LAMBDA most promising are
+ evaluated (in one batch; see evaluation.h) and replace as many individuals
+ as are not kept by the survivor selection strategy.  The rest are discarded
+ unevaluated, so fitness_evaluated, and everything that counts evaluations,
+ sees true evaluations only.
+
+ The surrogate learns from the initial population and from every evaluated
+ offspring, remembering the last SURROGATE_ARCHIVE (default 1000) of them;
+ predictions are based on SURROGATE_K (default 5) neighbors.  Until it has
+ seen that many genomes, or if SURROGATE_OVERSAMPLE is at most 1, this is
+ equivalent to steady_state.
+ */
+template <typename ParentSelectionStrategy, typename SurvivorSelectionStrategy>
+struct surrogate_steady_state {
+    typedef ParentSelectionStrategy parent_selection_type;
+    typedef SurvivorSelectionStrategy survivor_selection_type;
+
+    //! Apply this generational model to the population.
+    template <typename Population, typename EA>
+    void operator()(Population& population, EA& ea) {
+        typedef knn_surrogate<typename EA::genome_type> model_type;
+        typedef typename EA::fitness_function_type::direction_tag direction_tag;
+
+        model_type* model=static_cast<model_type*>(_model.get());
+        if(model == 0) {
+            _model.reset(new model_type(get<SURROGATE_ARCHIVE>(ea,1000), get<SURROGATE_K>(ea,5)));
+            model = static_cast<model_type*>(_model.get());
+            evaluate_pending(population.begin(), population.end(), ea);
+            for(typename Population::iterator i=population.begin(); i!=population.end(); ++i) {
+                model->add((*i)->genome(), real_fitness(**i));
+            }
+            model->rebuild();
+        }
+
+        // breed candidates, and keep the n most promising:
+        std::size_t n=get<STEADY_STATE_LAMBDA>(ea);
+        std::size_t m=n;
+        if(model->ready()) {
+            m = std::max(n, static_cast<std::size_t>(std::ceil(get<SURROGATE_OVERSAMPLE>(ea,1.0) * n)));
+        }
+        Population offspring;
+        recombine_n(population, offspring,
+                    parent_selection_type(m, population, ea),
+                    typename EA::recombination_operator_type(),
+                    m, ea);
+        mutate(offspring.begin(), offspring.end(), ea);
+        if(m > n) {
+            _ranked.clear();
+            for(std::size_t i=0; i<offspring.size(); ++i) {
+                _ranked.push_back(std::make_pair(model->predict(offspring[i]->genome()), i));
+            }
+            std::partial_sort(_ranked.begin(), _ranked.begin()+n, _ranked.end(), promising<direction_tag>());
+            Population screened;
+            for(std::size_t i=0; i<n; ++i) {
+                screened.push_back(offspring[_ranked[i].second]);
+            }
+            std::swap(offspring, screened);
+        }
+
+        evaluate_batch(offspring.begin(), offspring.end(), evaluation_pool(ea), ea);
+        for(typename Population::iterator i=offspring.begin(); i!=offspring.end(); ++i) {
+            model->add((*i)->genome(), real_fitness(**i));
+        }
+        model->rebuild();
+
+        // keep all but n individuals, and replace them with the offspring:
+        Population survivors;
+        if(population.size() > n) {
+            std::size_t k=population.size() - n;
+            survivor_selection_type sss(k, population, ea);
+            sss(population, survivors, k, ea);
+        }
+        survivors.insert(survivors.end(), offspring.begin(), offspring.end());
+        std::swap(population, survivors);
+    }
+
+    //! Orders (prediction, index) pairs from most to least promising.
+    template <typename DirectionTag>
+    struct promising {
+        bool operator()(const std::pair<double,std::size_t>& x, const std::pair<double,std::size_t>& y) const {
+            return better(x.first, y.first, DirectionTag())
+            || ((x.first == y.first) && (x.second < y.second));
+        }
+    };
+
+    std::shared_ptr<void> _model; //!< Surrogate (a knn_surrogate of the EA's genome type).
+    std::vector<std::pair<double,std::size_t> > _ranked; //!< Scratch space for screening.
+};
+
+#endif
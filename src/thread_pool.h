@@ -0,0 +1,162 @@
+/* thread_pool.h
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*! Fixed-size pool of worker threads for data-parallel loops.
+
+ Work is submitted as a loop over [0,n); workers claim indices from a shared
+ counter, so uneven per-index costs balance themselves.  A pool of size zero
+ runs everything on the calling thread.
+ */
+class thread_pool {
+public:
+    /*! A loop that has been handed to the pool.
+
+     Indices are claimed by the workers and by whichever thread calls wait(),
+     so waiting never idles the caller.
+     */
+    class job {
+    public:
+        typedef std::function<void(std::size_t)> body_type;
+
+        job(std::size_t n, const body_type& f) : _n(n), _next(0), _done(0), _f(f) {
+        }
+
+        //! Blocks until every index has been processed.
+        void wait() {
+            run();
+            std::unique_lock<std::mutex> lock(_mutex);
+            while(_done < _n) {
+                _cv.wait(lock);
+            }
+        }
+
+        //! Returns true if every index has been processed.
+        bool finished() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _done == _n;
+        }
+
+        //! Process indices until none remain to be claimed.
+        void run() {
+            for(std::size_t i=_next++; i<_n; i=_next++) {
+                _f(i);
+                std::lock_guard<std::mutex> lock(_mutex);
+                if(++_done == _n) {
+                    _cv.notify_all();
+                }
+            }
+        }
+
+    protected:
+        std::size_t _n; //!< Number of indices.
+        std::atomic<std::size_t> _next; //!< Next unclaimed index.
+        std::size_t _done; //!< Number of completed indices.
+        body_type _f; //!< Loop body.
+        std::mutex _mutex;
+        std::condition_variable _cv;
+    };
+
+    typedef std::shared_ptr<job> job_ptr;
+
+    //! Constructs a pool with n worker threads.
+    explicit thread_pool(std::size_t n) : _stop(false) {
+        for(std::size_t i=0; i<n; ++i) {
+            _workers.push_back(std::thread(&thread_pool::worker, this));
+        }
+    }
+
+    //! Stops and joins all workers; queued jobs are abandoned.
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+        for(std::size_t i=0; i<_workers.size(); ++i) {
+            _workers[i].join();
+        }
+    }
+
+    //! Returns the number of worker threads.
+    std::size_t size() const { return _workers.size(); }
+
+    //! Starts f(i) for i in [0,n) on the workers, and returns without waiting.
+    job_ptr submit(std::size_t n, const job::body_type& f) {
+        job_ptr j(new job(n, f));
+        if(!_workers.empty() && (n > 0)) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _queue.push_back(j);
+            }
+            _cv.notify_all();
+        }
+        return j;
+    }
+
+    //! Runs f(i) for i in [0,n), returning when all are complete.
+    void parallel_for(std::size_t n, const job::body_type& f) {
+        submit(n, f)->wait();
+    }
+
+protected:
+    //! Worker loop: help with the oldest job until it runs dry.
+    void worker() {
+        while(true) {
+            job_ptr j;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                while(!_stop && _queue.empty()) {
+                    _cv.wait(lock);
+                }
+                if(_stop) {
+                    return;
+                }
+                j = _queue.front();
+            }
+            j->run();
+            {
+                // the job has no more indices to claim; retire it:
+                std::lock_guard<std::mutex> lock(_mutex);
+                if(!_queue.empty() && (_queue.front() == j)) {
+                    _queue.pop_front();
+                }
+            }
+        }
+    }
+
+    bool _stop; //!< Set when the pool is shutting down.
+    std::vector<std::thread> _workers; //!< Worker threads.
+    std::deque<job_ptr> _queue; //!< Jobs with (possibly) unclaimed indices.
+    std::mutex _mutex;
+    std::condition_variable _cv;
+};
+
+#endif
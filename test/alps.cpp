@@ -0,0 +1,138 @@
+/* alps.cpp
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <map>
+#include <boost/test/unit_test.hpp>
+
+#include <ea/evolutionary_algorithm.h>
+#include <ea/fitness_functions/all_ones.h>
+#include <ea/selection/tournament.h>
+using namespace ealib;
+
+#include "alps.h"
+#include "static_events.h"
+#include "packed_bitstring.h"
+
+typedef evolutionary_algorithm
+< direct<packed_bitstring>
+, all_ones
+, packed_per_site_bitflip
+, packed_two_point_crossover
+, alps<selection::tournament< > >
+, ancestors::random_bitstring
+> alps_ea;
+
+//! Counts the evaluations of each individual, by name.
+template <typename EA>
+struct evaluation_count {
+    evaluation_count(EA& ea) : total(0) {
+    }
+
+    void fitness_evaluated(typename EA::individual_type& ind, EA& ea) {
+        ++count[static_cast<long>(ind.name())];
+        ++total;
+    }
+
+    std::map<long,int> count; //!< Evaluations of each individual.
+    std::size_t total; //!< All evaluations.
+};
+
+/* The individuals that restart the bottom layer are bred from on the update
+ they are born, and must be evaluated exactly once, before that.
+ */
+BOOST_AUTO_TEST_CASE(alps_restart_evaluates_once) {
+    alps_ea ea;
+    put<RNG_SEED>(1, ea);
+    put<REPRESENTATION_SIZE>(64, ea);
+    put<POPULATION_SIZE>(20, ea);
+    put<MUTATION_PER_SITE_P>(0.01, ea);
+    put<TOURNAMENT_SELECTION_N>(2, ea);
+    put<TOURNAMENT_SELECTION_K>(1, ea);
+    put<ALPS_LAYERS>(3, ea);
+    put<ALPS_ADMISSION_AGING_SCHEME>(0, ea);
+    put<ALPS_GAP_SIZE>(3, ea);
+    put<ALPS_REPLACEMENT_RATE>(0.2, ea);
+    put<ASYNC_THREADS>(0, ea);
+    ea.initialize();
+
+    static_events<alps_inheritance, evaluation_count>::type<alps_ea> events(ea);
+    evaluation_count<alps_ea>& c=events.handler<evaluation_count>();
+    generate_ancestors(ancestors::random_bitstring(), 20, ea);
+
+    // layers fill up from the founders, in layer 0:
+    for(int u=0; u<3; ++u) {
+        ea.update();
+    }
+    std::size_t before=c.total;
+
+    // update 3 restarts layer 0 with 20 individuals, and all 3 layers breed:
+    ea.update();
+    BOOST_CHECK_EQUAL(c.total - before, 20u + 3u*4u);
+
+    for(std::map<long,int>::iterator i=c.count.begin(); i!=c.count.end(); ++i) {
+        BOOST_CHECK_EQUAL(i->second, 1);
+    }
+}
+
+//! All ones, minimized: the fewer ones, the fitter.
+struct fewest_ones : all_ones {
+    typedef minimizeS direction_tag;
+};
+
+typedef evolutionary_algorithm
+< direct<packed_bitstring>
+, fewest_ones
+, packed_per_site_bitflip
+, packed_two_point_crossover
+, alps<selection::tournament< > >
+, ancestors::random_bitstring
+> alps_min_ea;
+
+/* Layers are truncated from their weakest members, which are the fittest by
+ raw value when fitness is minimized.
+ */
+BOOST_AUTO_TEST_CASE(alps_truncates_weakest_when_minimizing) {
+    alps_min_ea ea;
+    put<RNG_SEED>(1, ea);
+    put<REPRESENTATION_SIZE>(64, ea);
+    put<POPULATION_SIZE>(20, ea);
+    put<MUTATION_PER_SITE_P>(0.01, ea);
+    put<TOURNAMENT_SELECTION_N>(2, ea);
+    put<TOURNAMENT_SELECTION_K>(1, ea);
+    put<ALPS_LAYERS>(2, ea);
+    put<ALPS_ADMISSION_AGING_SCHEME>(0, ea);
+    put<ALPS_GAP_SIZE>(100, ea);
+    put<ALPS_REPLACEMENT_RATE>(0.5, ea);
+    put<ASYNC_THREADS>(0, ea);
+    ea.initialize();
+
+    static_events<alps_inheritance>::type<alps_min_ea> events(ea);
+    generate_ancestors(ancestors::random_bitstring(), 20, ea);
+
+    double before=0.0;
+    for(alps_min_ea::iterator i=ea.begin(); i!=ea.end(); ++i) {
+        before = std::max(before, static_cast<double>(i->fitness()));
+    }
+    for(int u=0; u<20; ++u) {
+        ea.update();
+    }
+    for(alps_min_ea::iterator i=ea.begin(); i!=ea.end(); ++i) {
+        BOOST_CHECK(static_cast<double>(i->fitness()) <= before);
+    }
+}
@@ -0,0 +1,153 @@
+/* lineage.cpp
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include <ea/evolutionary_algorithm.h>
+#include <ea/fitness_functions/all_ones.h>
+#include <ea/selection/tournament.h>
+#include <ea/selection/random.h>
+#include <ea/line_of_descent.h>
+using namespace ealib;
+
+#include "async_steady_state.h"
+#include "lineage_lag.h"
+#include "static_events.h"
+#include "packed_bitstring.h"
+
+//! Ancestors within reach of an individual's evaluation, when it was born.
+LIBEA_MD_DECL(TEST_REACH_AT_BIRTH, "test.reach_at_birth", int);
+//! Ancestors within reach of an individual's evaluation, when it ran.
+LIBEA_MD_DECL(TEST_REACH_AT_EVALUATION, "test.reach_at_evaluation", int);
+
+/*! All ones, with the walk the delay fitness functions take: DELAY_GENERATIONS
+ ancestors, and the parents of the last of them.  Records how many of those
+ DELAY_GENERATIONS+1 ancestors were still reachable.
+ */
+struct walking_all_ones : all_ones {
+    template <typename Individual, typename EA>
+    double operator()(Individual& ind, EA& ea) {
+        double w=static_cast<double>(all_ones::operator()(ind, ea));
+        put<DELAY_W_REAL>(w, ind);
+        put<TEST_REACH_AT_EVALUATION>(walk_ancestors(ind, get<DELAY_GENERATIONS>(ea) + 1, [](double) { }, ea), ind);
+        return w;
+    }
+};
+
+typedef evolutionary_algorithm
+< direct<packed_bitstring>
+, walking_all_ones
+, packed_per_site_bitflip
+, packed_two_point_crossover
+, async_steady_state<selection::tournament< >, selection::random< > >
+, ancestors::random_bitstring
+, dont_stop
+, fill_population
+, default_lifecycle
+, lod_trait
+> lineage_ea;
+
+//! Checks that each evaluation could reach as many ancestors as it could at birth.
+template <typename EA>
+struct reach_check {
+    reach_check(EA& ea) : evaluated(0) {
+    }
+
+    void inheritance(typename EA::population_type& parents, typename EA::individual_type& offspring, EA& ea) {
+        put<TEST_REACH_AT_BIRTH>(1 + walk_ancestors(*parents.front(), get<DELAY_GENERATIONS>(ea), [](double) { }, ea), offspring);
+    }
+
+    void fitness_evaluated(typename EA::individual_type& ind, EA& ea) {
+        if(exists<TEST_REACH_AT_BIRTH>(ind)) {
+            BOOST_CHECK_EQUAL(get<TEST_REACH_AT_EVALUATION>(ind), get<TEST_REACH_AT_BIRTH>(ind));
+            ++evaluated;
+        }
+    }
+
+    std::size_t evaluated; //!< Offspring checked.
+};
+
+/* With ASYNC_OVERLAP, offspring are evaluated during the update after they
+ were bred, after lineage_lag has truncated the line of descent; the walk
+ their evaluation takes must be left intact.  With no worker threads the
+ evaluations run when the batch is waited on, so the check is deterministic.
+ */
+BOOST_AUTO_TEST_CASE(lineage_truncation_spares_inflight_offspring) {
+    lineage_ea ea;
+    put<RNG_SEED>(1, ea);
+    put<REPRESENTATION_SIZE>(64, ea);
+    put<POPULATION_SIZE>(20, ea);
+    put<STEADY_STATE_LAMBDA>(10, ea);
+    put<MUTATION_PER_SITE_P>(0.02, ea);
+    put<TOURNAMENT_SELECTION_N>(2, ea);
+    put<TOURNAMENT_SELECTION_K>(1, ea);
+    put<ASYNC_THREADS>(0, ea);
+    put<ASYNC_OVERLAP>(1, ea);
+    put<DELAY_GENERATIONS>(3, ea);
+    put<LINEAGE_TRUNCATE_LOD>(1, ea);
+    ea.initialize();
+
+    lod_event<lineage_ea> lod(ea);
+    static_events<reach_check, lineage_lag>::type<lineage_ea> events(ea);
+    generate_ancestors(ancestors::random_bitstring(), 20, ea);
+    for(int u=0; u<50; ++u) {
+        ea.update();
+    }
+    BOOST_CHECK(events.handler<reach_check>().evaluated > 0u);
+}
+
+//! Checks that the unrolled walk of N ancestors visits those the runtime walk does.
+template <int N, typename EA>
+void check_unrolled_walk(typename EA::individual_type& ind, EA& ea) {
+    std::vector<double> a, b;
+    int n=walk_ancestors<N>(ind, [&a](double w) { a.push_back(w); }, ea);
+    int m=walk_ancestors(ind, N, [&b](double w) { b.push_back(w); }, ea);
+    BOOST_CHECK_EQUAL(n, m);
+    BOOST_CHECK(a == b);
+}
+
+/* Walks with a compile-time bound, as delay_walk takes at the expected depth,
+ match those with a runtime bound, including those cut short by the start of
+ the line of descent.
+ */
+BOOST_AUTO_TEST_CASE(lineage_unrolled_walk_matches_runtime) {
+    lineage_ea ea;
+    put<RNG_SEED>(1, ea);
+    put<REPRESENTATION_SIZE>(64, ea);
+    put<POPULATION_SIZE>(20, ea);
+    put<STEADY_STATE_LAMBDA>(10, ea);
+    put<MUTATION_PER_SITE_P>(0.02, ea);
+    put<TOURNAMENT_SELECTION_N>(2, ea);
+    put<TOURNAMENT_SELECTION_K>(1, ea);
+    put<ASYNC_THREADS>(0, ea);
+    put<DELAY_GENERATIONS>(3, ea);
+    ea.initialize();
+
+    lod_event<lineage_ea> lod(ea);
+    generate_ancestors(ancestors::random_bitstring(), 20, ea);
+    for(int u=0; u<20; ++u) {
+        ea.update();
+        for(lineage_ea::iterator i=ea.begin(); i!=ea.end(); ++i) {
+            check_unrolled_walk<0>(*i, ea);
+            check_unrolled_walk<1>(*i, ea);
+            check_unrolled_walk<8>(*i, ea);
+        }
+    }
+}
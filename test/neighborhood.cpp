@@ -0,0 +1,122 @@
+/* neighborhood.cpp
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include <ea/evolutionary_algorithm.h>
+#include <ea/selection/tournament.h>
+#include <ea/selection/random.h>
+using namespace ealib;
+
+#include "async_steady_state.h"
+#include "counter_rng.h"
+#include "neighborhood.h"
+#include "packed_bitstring.h"
+
+typedef evolutionary_algorithm
+< direct<packed_bitstring>
+, hashed_nk_model
+, packed_per_site_bitflip
+, packed_two_point_crossover
+, async_steady_state<selection::tournament< >, selection::random< > >
+, ancestors::random_bitstring
+> neighborhood_ea;
+
+//! Returns a hashed NK landscape of the given shape.
+hashed_nk_model landscape(std::size_t n, std::size_t k) {
+    neighborhood_ea ea;
+    put<NK_MODEL_N>(static_cast<int>(n), ea);
+    put<NK_MODEL_K>(static_cast<int>(k), ea);
+    put<FF_RNG_SEED>(42, ea);
+    hashed_nk_model m;
+    m.initialize(ea);
+    return m;
+}
+
+/* Checks the scanned fitness and every delta of nb against full evaluations
+ of g and of each of its one-bit neighbors.
+ */
+template <typename Genome>
+void check_deltas(const hashed_nk_model& m, const nk_neighborhood& nb, const Genome& g) {
+    double w=m.fitness(g);
+    BOOST_CHECK_SMALL(nb.fitness() - w, 1e-12);
+    for(std::size_t j=0; j<g.size(); ++j) {
+        Genome h(g);
+        flip_bit(h, j);
+        BOOST_CHECK_SMALL(nb.deltas()[j] - (m.fitness(h) - w), 1e-12);
+    }
+}
+
+/* Shapes to test: the incremental update of 2K+1 deltas when 2K+1 < N, and
+ the full rescan when the flipped neighborhoods cover the genome (2K+1 >= N).
+ */
+const std::size_t shapes[][2]={{32,4}, {32,8}, {100,3}, {130,10}, {9,4}, {8,4}, {5,4}, {2,1}};
+
+/* Deltas match full evaluations after a scan, and after each of a random
+ walk of flips, for packed and plain bitstrings.
+ */
+BOOST_AUTO_TEST_CASE(nk_neighborhood_deltas_match_fitness) {
+    for(std::size_t s=0; s<sizeof(shapes)/sizeof(shapes[0]); ++s) {
+        const std::size_t n=shapes[s][0], k=shapes[s][1];
+        hashed_nk_model m=landscape(n, k);
+        for(std::size_t t=0; t<5; ++t) {
+            counter_rng rng(1, 0, s, t);
+            packed_bitstring g;
+            random_bits(g, n, rng);
+            std::vector<int> v(g.begin(), g.end());
+
+            nk_neighborhood nb, nv;
+            BOOST_CHECK_SMALL(nb.scan(m, g) - m.fitness(g), 1e-12);
+            nv.scan(m, v);
+            check_deltas(m, nb, g);
+            check_deltas(m, nv, v);
+
+            for(std::size_t i=0; i<20; ++i) {
+                std::size_t j=rng.uniform_integer(0, static_cast<int>(n));
+                flip_bit(g, j);
+                nb.flip(m, j);
+                flip_bit(v, j);
+                nv.flip(m, j);
+                check_deltas(m, nb, g);
+                check_deltas(m, nv, v);
+            }
+        }
+    }
+}
+
+/* Hill climbing ends on a genome with no better one-bit neighbor, and the
+ neighborhood it leaves behind is that genome's.
+ */
+BOOST_AUTO_TEST_CASE(nk_neighborhood_hill_climb_ends_on_peak) {
+    for(std::size_t s=0; s<sizeof(shapes)/sizeof(shapes[0]); ++s) {
+        const std::size_t n=shapes[s][0], k=shapes[s][1];
+        hashed_nk_model m=landscape(n, k);
+        counter_rng rng(2, 0, s, 0);
+        packed_bitstring g;
+        random_bits(g, n, rng);
+        double before=m.fitness(g);
+
+        nk_neighborhood nb;
+        nb.hill_climb(m, g, 10*n);
+        BOOST_CHECK(m.fitness(g) >= before);
+        BOOST_CHECK(nb.classify() != nk_neighborhood::SLOPE);
+        check_deltas(m, nb, g);
+    }
+}
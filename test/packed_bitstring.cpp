@@ -0,0 +1,251 @@
+/* packed_bitstring.cpp
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include "counter_rng.h"
+#include "packed_bitstring.h"
+
+//! Unpacked bitstring, as libea's bitstring stores it.
+typedef std::vector<int> plain_bitstring;
+
+//! Returns the bits of g, unpacked.
+plain_bitstring unpack(const packed_bitstring& g) {
+    plain_bitstring p(g.size());
+    for(std::size_t i=0; i<g.size(); ++i) {
+        p[i] = g[i];
+    }
+    return p;
+}
+
+//! Returns n random bits, set one at a time through the proxies.
+packed_bitstring random_packed(std::size_t n, counter_rng& rng) {
+    packed_bitstring g(n);
+    for(std::size_t i=0; i<n; ++i) {
+        g[i] = rng.uniform_integer(0, 2);
+    }
+    return g;
+}
+
+//! Lengths on either side of word boundaries.
+const std::size_t lengths[]={1, 63, 64, 65, 127, 128, 129, 200};
+
+/* Flipping each bit with probability p, a word at a time, flips the same bits
+ as visiting each site in turn, given the same geometric gaps.
+ */
+BOOST_AUTO_TEST_CASE(packed_per_site_bitflip_matches_plain) {
+    const double ps[]={0.0, 0.01, 0.1, 0.5, 1.0};
+    for(std::size_t l=0; l<sizeof(lengths)/sizeof(lengths[0]); ++l) {
+        for(std::size_t k=0; k<sizeof(ps)/sizeof(ps[0]); ++k) {
+            counter_rng init(1, 0, l, k);
+            packed_bitstring g=random_packed(lengths[l], init);
+            plain_bitstring p=unpack(g);
+
+            counter_rng rng(2, 0, l, k);
+            counter_rng ref=rng;
+            per_site_bitflip(g, ps[k], rng);
+            if(ps[k] >= 1.0) {
+                for(std::size_t i=0; i<p.size(); ++i) {
+                    p[i] ^= 1;
+                }
+            } else if(ps[k] > 0.0) {
+                const double lq=std::log(1.0 - ps[k]);
+                for(std::size_t i=geometric_gap(lq, p.size(), ref); i<p.size(); i+=1+geometric_gap(lq, p.size(), ref)) {
+                    p[i] ^= 1;
+                }
+            }
+            BOOST_CHECK(unpack(g) == p);
+            BOOST_CHECK_EQUAL(g.count(), static_cast<std::size_t>(std::count(p.begin(), p.end(), 1)));
+        }
+    }
+}
+
+/* Each site is flipped with probability p.
+ */
+BOOST_AUTO_TEST_CASE(packed_per_site_bitflip_rate) {
+    const std::size_t n=200, trials=2000;
+    const double p=0.05;
+    std::vector<double> flips(n, 0.0);
+    for(std::size_t t=0; t<trials; ++t) {
+        packed_bitstring g(n);
+        counter_rng rng(3, 0, t, 0);
+        per_site_bitflip(g, p, rng);
+        for(std::size_t i=0; i<n; ++i) {
+            flips[i] += g[i];
+        }
+    }
+    double total=0.0;
+    for(std::size_t i=0; i<n; ++i) {
+        total += flips[i];
+    }
+    // expected n*trials*p = 20000, sd ~ 138:
+    BOOST_CHECK_CLOSE(total, n * trials * p, 3.0);
+    // the first and last sites (and those at word boundaries) are not special:
+    BOOST_CHECK_CLOSE(flips[0] + flips[63] + flips[64] + flips[n-1], 4.0 * trials * p, 30.0);
+}
+
+/* Two-point crossover takes [first,last) from b and the rest from a, for
+ every pair of cut points.
+ */
+BOOST_AUTO_TEST_CASE(packed_two_point_blend_matches_plain) {
+    for(std::size_t l=0; l<sizeof(lengths)/sizeof(lengths[0]); ++l) {
+        const std::size_t n=lengths[l];
+        counter_rng rng(4, 0, l, 0);
+        packed_bitstring a=random_packed(n, rng), b=random_packed(n, rng);
+        plain_bitstring pa=unpack(a), pb=unpack(b);
+        for(std::size_t first=0; first<=n; ++first) {
+            for(std::size_t last=first; last<=n; ++last) {
+                packed_bitstring o;
+                two_point_blend(a, b, first, last, o);
+                plain_bitstring p(pa);
+                std::copy(pb.begin()+first, pb.begin()+last, p.begin()+first);
+                BOOST_REQUIRE(unpack(o) == p);
+            }
+        }
+    }
+}
+
+/* A crossover that changes nothing shares the first parent's words.
+ */
+BOOST_AUTO_TEST_CASE(packed_two_point_blend_shares_unchanged) {
+    counter_rng rng(5, 0, 0, 0);
+    packed_bitstring a=random_packed(130, rng);
+    packed_bitstring b(a);
+    b.flip(100);
+    packed_bitstring o;
+    const packed_bitstring& co=o;
+    const packed_bitstring& ca=a;
+    two_point_blend(a, b, 10, 90, o);
+    BOOST_CHECK(o == a);
+    BOOST_CHECK(&co.words()[0] == &ca.words()[0]);
+    two_point_blend(a, b, 90, 110, o);
+    BOOST_CHECK(o == b);
+    BOOST_CHECK(&co.words()[0] != &ca.words()[0]);
+}
+
+/* Random bits fill 16 bits per draw from an ealib-style RNG, and a whole word
+ per draw from a counter_rng stream, least significant bits first.
+ */
+BOOST_AUTO_TEST_CASE(packed_random_bits_matches_plain) {
+    for(std::size_t l=0; l<sizeof(lengths)/sizeof(lengths[0]); ++l) {
+        const std::size_t n=lengths[l];
+
+        // through the generic (ealib RNG) overload, 16 bits per draw:
+        struct generic_rng {
+            counter_rng r;
+            int uniform_integer(int min, int max) { return r.uniform_integer(min, max); }
+        } rng={counter_rng(6, 0, l, 0)};
+        counter_rng ref(6, 0, l, 0);
+        packed_bitstring g(3, 1);
+        random_bits(g, n, rng);
+        plain_bitstring p((n + 63) / 64 * 64);
+        for(std::size_t i=0; i<p.size(); i+=16) {
+            int r=ref.uniform_integer(0, 0x10000);
+            for(std::size_t j=0; j<16; ++j) {
+                p[i+j] = (r >> j) & 1;
+            }
+        }
+        p.resize(n);
+        BOOST_CHECK_EQUAL(g.size(), n);
+        BOOST_CHECK(unpack(g) == p);
+
+        // through a counter_rng stream, 64 bits per draw:
+        counter_rng stream(7, 0, l, 0);
+        counter_rng stream_ref(stream);
+        random_bits(g, n, stream);
+        p.assign((n + 63) / 64 * 64, 0);
+        for(std::size_t i=0; i<p.size(); i+=64) {
+            boost::uint64_t r=stream_ref.next64();
+            for(std::size_t j=0; j<64; ++j) {
+                p[i+j] = static_cast<int>((r >> j) & 1);
+            }
+        }
+        p.resize(n);
+        BOOST_CHECK(unpack(g) == p);
+        // bits beyond size() stay clear:
+        BOOST_CHECK_EQUAL(g.count(), static_cast<std::size_t>(std::count(p.begin(), p.end(), 1)));
+    }
+}
+
+/* Hamming distance counts the sites at which two bitstrings differ.
+ */
+BOOST_AUTO_TEST_CASE(packed_hamming_distance_matches_plain) {
+    for(std::size_t l=0; l<sizeof(lengths)/sizeof(lengths[0]); ++l) {
+        for(std::size_t t=0; t<10; ++t) {
+            counter_rng rng(8, 0, l, t);
+            packed_bitstring a=random_packed(lengths[l], rng), b=random_packed(lengths[l], rng);
+            plain_bitstring pa=unpack(a), pb=unpack(b);
+            std::size_t d=0;
+            for(std::size_t i=0; i<pa.size(); ++i) {
+                d += (pa[i] != pb[i]);
+            }
+            BOOST_CHECK_EQUAL(hamming_distance(a, b), d);
+            BOOST_CHECK_EQUAL(hamming_distance(a, a), 0u);
+        }
+    }
+}
+
+/* Copies share their words until one of them is written, and reading
+ (including through the proxies and iterators) never copies.
+ */
+BOOST_AUTO_TEST_CASE(packed_copy_on_write) {
+    counter_rng rng(9, 0, 0, 0);
+    packed_bitstring a=random_packed(130, rng);
+    plain_bitstring pa=unpack(a);
+
+    packed_bitstring b(a);
+    BOOST_CHECK_EQUAL(a.shares(), 2);
+    const packed_bitstring& cb=b;
+    const packed_bitstring& ca=a;
+    BOOST_CHECK(&ca.words()[0] == &cb.words()[0]);
+
+    // reads:
+    int ones=0;
+    for(std::size_t i=0; i<b.size(); ++i) {
+        ones += b[i];
+    }
+    for(packed_bitstring::iterator i=b.begin(); i!=b.end(); ++i) {
+        ones += *i;
+    }
+    BOOST_CHECK_EQUAL(static_cast<std::size_t>(ones), 2 * a.count());
+    BOOST_CHECK_EQUAL(hamming_distance(a, b), 0u);
+    BOOST_CHECK(a == b);
+    BOOST_CHECK_EQUAL(a.shares(), 2);
+
+    // a mutation that flips nothing leaves them shared:
+    per_site_bitflip(b, 0.0, rng);
+    BOOST_CHECK_EQUAL(a.shares(), 2);
+
+    // the first write copies:
+    b[129] = !b[129];
+    BOOST_CHECK_EQUAL(a.shares(), 1);
+    BOOST_CHECK_EQUAL(b.shares(), 1);
+    BOOST_CHECK(&ca.words()[0] != &cb.words()[0]);
+    BOOST_CHECK(unpack(a) == pa);
+    BOOST_CHECK_EQUAL(hamming_distance(a, b), 1u);
+
+    // and so does a flip of a fresh copy:
+    packed_bitstring c(a);
+    c.flip(0);
+    BOOST_CHECK(unpack(a) == pa);
+    BOOST_CHECK_EQUAL(c[0], 1 - pa[0]);
+}
@@ -0,0 +1,153 @@
+/* qhfc.cpp
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <map>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include <ea/evolutionary_algorithm.h>
+#include <ea/fitness_functions/all_ones.h>
+#include <ea/selection/tournament.h>
+using namespace ealib;
+
+#include "qhfc.h"
+#include "static_events.h"
+#include "packed_bitstring.h"
+
+//! All ones, minimized: the fewer ones, the fitter.
+struct fewest_ones_qhfc : all_ones {
+    typedef minimizeS direction_tag;
+};
+
+typedef evolutionary_algorithm
+< direct<packed_bitstring>
+, all_ones
+, packed_per_site_bitflip
+, packed_two_point_crossover
+, qhfc<selection::tournament< > >
+, ancestors::random_bitstring
+> qhfc_ea;
+
+typedef evolutionary_algorithm
+< direct<packed_bitstring>
+, fewest_ones_qhfc
+, packed_per_site_bitflip
+, packed_two_point_crossover
+, qhfc<selection::tournament< > >
+, ancestors::random_bitstring
+> qhfc_min_ea;
+
+//! Counts the evaluations of each individual, by name.
+template <typename EA>
+struct qhfc_evaluation_count {
+    qhfc_evaluation_count(EA& ea) {
+    }
+
+    void fitness_evaluated(typename EA::individual_type& ind, EA& ea) {
+        ++count[static_cast<long>(ind.name())];
+    }
+
+    std::map<long,int> count; //!< Evaluations of each individual.
+};
+
+//! Configures a small QHFC run of 4 levels.
+template <typename EA>
+void configure_qhfc(EA& ea) {
+    put<RNG_SEED>(1, ea);
+    put<REPRESENTATION_SIZE>(64, ea);
+    put<POPULATION_SIZE>(20, ea);
+    put<METAPOPULATION_SIZE>(4, ea);
+    put<MUTATION_PER_SITE_P>(0.01, ea);
+    put<TOURNAMENT_SELECTION_N>(2, ea);
+    put<TOURNAMENT_SELECTION_K>(1, ea);
+    put<QHFC_POP_SCALE>(0.8, ea);
+    put<QHFC_BREED_TOP_FREQ>(2, ea);
+    put<QHFC_DETECT_EXPORT_NUM>(2, ea);
+    put<QHFC_PERCENT_REFILL>(0.25, ea);
+    put<QHFC_CATCHUP_GEN>(5, ea);
+    put<QHFC_NO_PROGRESS_GEN>(3, ea);
+    put<ASYNC_THREADS>(0, ea);
+}
+
+//! Returns the mean fitness of each of the n levels (0 for empty levels).
+template <typename EA>
+std::vector<double> level_means(EA& ea, std::size_t n) {
+    std::vector<double> w(n, 0.0), c(n, 0.0);
+    for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
+        std::size_t l=get<QHFC_LEVEL>(*i);
+        w[l] += static_cast<double>(i->fitness());
+        c[l] += 1.0;
+    }
+    for(std::size_t l=0; l<n; ++l) {
+        w[l] = (c[l] > 0.0) ? (w[l] / c[l]) : 0.0;
+    }
+    return w;
+}
+
+/* No level outgrows its capacity, and every individual, including those that
+ refill the bottom level, is evaluated exactly once.
+ */
+BOOST_AUTO_TEST_CASE(qhfc_levels_keep_capacity) {
+    qhfc_ea ea;
+    configure_qhfc(ea);
+    ea.initialize();
+
+    static_events<qhfc_evaluation_count>::type<qhfc_ea> events(ea);
+    qhfc_evaluation_count<qhfc_ea>& c=events.handler<qhfc_evaluation_count>();
+    generate_ancestors(ancestors::random_bitstring(), 20, ea);
+
+    for(int u=0; u<50; ++u) {
+        ea.update();
+        std::vector<std::size_t> n(4, 0);
+        for(qhfc_ea::iterator i=ea.begin(); i!=ea.end(); ++i) {
+            ++n[get<QHFC_LEVEL>(*i)];
+        }
+        for(std::size_t l=0; l<4; ++l) {
+            BOOST_CHECK(n[l] <= qhfc<selection::tournament< > >::capacity(l, ea));
+        }
+    }
+    BOOST_CHECK(level_means(ea, 4)[3] > 0.0);
+
+    for(std::map<long,int>::iterator i=c.count.begin(); i!=c.count.end(); ++i) {
+        BOOST_CHECK_EQUAL(i->second, 1);
+    }
+}
+
+/* Higher levels hold fitter individuals, in the fitness function's direction.
+ */
+BOOST_AUTO_TEST_CASE(qhfc_levels_ordered_in_direction) {
+    qhfc_ea up;
+    configure_qhfc(up);
+    up.initialize();
+    generate_ancestors(ancestors::random_bitstring(), 20, up);
+
+    qhfc_min_ea down;
+    configure_qhfc(down);
+    down.initialize();
+    generate_ancestors(ancestors::random_bitstring(), 20, down);
+
+    for(int u=0; u<50; ++u) {
+        up.update();
+        down.update();
+    }
+    std::vector<double> w=level_means(up, 4);
+    BOOST_CHECK(w[3] > w[0]);
+    w = level_means(down, 4);
+    BOOST_CHECK(w[3] < w[0]);
+}
@@ -0,0 +1,187 @@
+/* run_log.cpp
+ *
+ * This file is part of the Himalaya project.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <map>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include <ea/evolutionary_algorithm.h>
+#include <ea/fitness_functions/all_ones.h>
+#include <ea/selection/tournament.h>
+#include <ea/selection/random.h>
+#include <ea/line_of_descent.h>
+using namespace ealib;
+
+#include "async_steady_state.h"
+#include "qhfc.h"
+#include "run_log.h"
+#include "static_events.h"
+#include "packed_bitstring.h"
+
+typedef evolutionary_algorithm
+< direct<packed_bitstring>
+, generation_delay<all_ones>
+, packed_per_site_bitflip
+, packed_two_point_crossover
+, async_steady_state<selection::tournament< >, delayed_elitism<selection::random< > > >
+, ancestors::random_bitstring
+, dont_stop
+, fill_population
+, default_lifecycle
+, lod_trait
+> run_log_ea;
+
+typedef evolutionary_algorithm
+< direct<packed_bitstring>
+, all_ones
+, packed_per_site_bitflip
+, packed_two_point_crossover
+, qhfc<selection::tournament< > >
+, ancestors::random_bitstring
+> run_log_qhfc_ea;
+
+//! What the live run knew about an individual at the end of an update.
+struct live_individual {
+    packed_bitstring genome;
+    double w;
+    std::vector<long> parents;
+};
+
+//! The population at the end of an update, by name.
+typedef std::map<long, live_individual> live_population;
+
+//! Records the parents of each offspring, and the population at the end of each update.
+template <typename EA>
+struct live_history {
+    live_history(EA& ea) {
+    }
+
+    void inheritance(typename EA::population_type& parents, typename EA::individual_type& offspring, EA& ea) {
+        std::vector<long>& p=_parents[static_cast<long>(offspring.name())];
+        for(typename EA::population_type::iterator i=parents.begin(); i!=parents.end(); ++i) {
+            p.push_back(static_cast<long>((*i)->name()));
+        }
+    }
+
+    void end_of_update(EA& ea) {
+        updates.push_back(live_population());
+        live_population& pop=updates.back();
+        for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
+            live_individual& l=pop[static_cast<long>(i->name())];
+            l.genome = i->genome();
+            l.w = static_cast<double>(i->fitness());
+            l.parents = _parents[static_cast<long>(i->name())];
+        }
+    }
+
+    std::map<long, std::vector<long> > _parents; //!< Parents of each offspring.
+    std::vector<live_population> updates; //!< Population at the end of each update.
+};
+
+//! Replays run_log.bin, and checks each update against the live run.
+void check_replay(const std::vector<live_population>& live) {
+    run_log::replay<packed_bitstring> r("run_log.bin");
+    std::size_t u=0;
+    while(r.next()) {
+        BOOST_REQUIRE(u < live.size());
+        BOOST_CHECK_EQUAL(r.update(), u);
+        const live_population& pop=live[u];
+        BOOST_CHECK_EQUAL(r.population().size(), pop.size());
+        for(live_population::const_iterator i=pop.begin(); i!=pop.end(); ++i) {
+            BOOST_REQUIRE(r.population().count(i->first) == 1);
+            const run_log::replay<packed_bitstring>::individual& ind=r[i->first];
+            BOOST_CHECK(r.genome(i->first) == i->second.genome);
+            BOOST_CHECK(ind.evaluated);
+            BOOST_CHECK_EQUAL(ind.w, i->second.w);
+            BOOST_CHECK_EQUAL(ind.parents.size(), i->second.parents.size());
+            for(std::size_t j=0; (j<ind.parents.size()) && (j<i->second.parents.size()); ++j) {
+                BOOST_CHECK_EQUAL(static_cast<long>(ind.parents[j]), i->second.parents[j]);
+            }
+        }
+        ++u;
+    }
+    BOOST_CHECK_EQUAL(u, live.size());
+    std::remove("run_log.bin");
+}
+
+/* Replaying the log of a delay run, with immigrants, rebuilds the population,
+ genomes, fitnesses and parents of every update.
+ */
+BOOST_AUTO_TEST_CASE(run_log_replays_delay_run) {
+    run_log_ea ea;
+    put<RNG_SEED>(1, ea);
+    put<REPRESENTATION_SIZE>(128, ea);
+    put<POPULATION_SIZE>(50, ea);
+    put<STEADY_STATE_LAMBDA>(10, ea);
+    put<MUTATION_PER_SITE_P>(0.01, ea);
+    put<TOURNAMENT_SELECTION_N>(2, ea);
+    put<TOURNAMENT_SELECTION_K>(1, ea);
+    put<ELITISM_N>(2, ea);
+    put<DELAY_GENERATIONS>(4, ea);
+    put<DELAY_RANDOM_INSERT>(0.05, ea);
+    put<ASYNC_THREADS>(0, ea);
+    put<RUN_LOG>(1, ea);
+    ea.initialize();
+
+    std::vector<live_population> live;
+    {
+        static_events<random_individuals, run_recorder, live_history>::type<run_log_ea> events(ea);
+        generate_ancestors(ancestors::random_bitstring(), 50, ea);
+        for(int u=0; u<100; ++u) {
+            ea.update();
+        }
+        live = events.handler<live_history>().updates;
+    }
+    check_replay(live);
+}
+
+/* The same holds for a QHFC run, which refills its bottom level with random
+ individuals.
+ */
+BOOST_AUTO_TEST_CASE(run_log_replays_qhfc_run) {
+    run_log_qhfc_ea ea;
+    put<RNG_SEED>(1, ea);
+    put<REPRESENTATION_SIZE>(128, ea);
+    put<POPULATION_SIZE>(20, ea);
+    put<METAPOPULATION_SIZE>(3, ea);
+    put<MUTATION_PER_SITE_P>(0.01, ea);
+    put<TOURNAMENT_SELECTION_N>(2, ea);
+    put<TOURNAMENT_SELECTION_K>(1, ea);
+    put<QHFC_POP_SCALE>(0.8, ea);
+    put<QHFC_BREED_TOP_FREQ>(2, ea);
+    put<QHFC_DETECT_EXPORT_NUM>(2, ea);
+    put<QHFC_PERCENT_REFILL>(0.25, ea);
+    put<QHFC_CATCHUP_GEN>(5, ea);
+    put<QHFC_NO_PROGRESS_GEN>(3, ea);
+    put<ASYNC_THREADS>(0, ea);
+    put<RUN_LOG>(1, ea);
+    ea.initialize();
+
+    std::vector<live_population> live;
+    {
+        static_events<run_recorder, live_history>::type<run_log_qhfc_ea> events(ea);
+        generate_ancestors(ancestors::random_bitstring(), 20, ea);
+        for(int u=0; u<50; ++u) {
+            ea.update();
+        }
+        live = events.handler<live_history>().updates;
+    }
+    check_replay(live);
+}